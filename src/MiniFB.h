@@ -10,6 +10,16 @@ extern "C" {
 
 #define MFB_RGB(r, g, b) (((unsigned int)r) << 16) | (((unsigned int)g) << 8) | b
 
+// mfb_keystatus() is indexed by win32 virtual key codes on every backend
+#ifndef _WIN32
+#define VK_RETURN 0x0D
+#define VK_SPACE  0x20
+#define VK_LEFT   0x25
+#define VK_UP     0x26
+#define VK_RIGHT  0x27
+#define VK_DOWN   0x28
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 // Create a window that is used to display the buffer sent into the mfb_update function, returns 0 if fails
@@ -23,6 +33,15 @@ void mfb_set_pallete_array(const uint32_t *new_palette, uint8_t start, uint8_t c
 // Close the window
 void mfb_close();
 char * mfb_keystatus();
+
+#ifdef DENDY_HEADLESS
+// Headless backend only. mfb_update() returns -1 after max_frames frames (0 - run forever).
+// input_script: pad input replayed per frame, see input_script.h for the format
+// dump_path: "*.ppm" writes RGB frames, anything else writes raw 8-bit indexed frames.
+//            A printf pattern ("frame%05u.ppm") writes every frame to its own file, otherwise
+//            PPM keeps only the last frame and raw appends all frames to one stream.
+int mfb_headless_setup(unsigned max_frames, const char* input_script, const char* dump_path);
+#endif
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #ifdef __cplusplus
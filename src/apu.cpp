@@ -0,0 +1,425 @@
+#include "apu.h"
+
+#include <algorithm>
+
+namespace dendy {
+
+// Output frames are ended by end_frame() once a video frame, and every MAX_FRAME cycles if it isn't called
+static constexpr uint32_t MAX_FRAME = 1 << 16;
+
+// Weight of a step of one in each channel's level, in 16-bit sample units. The linear approximation of the
+// 2A03 mixer: 0.00752 per pulse step, 0.00851 triangle, 0.00494 noise and 0.00335 DMC, full scale 32767.
+static constexpr int PULSE_WEIGHT = 246;
+static constexpr int TRIANGLE_WEIGHT = 279;
+static constexpr int NOISE_WEIGHT = 162;
+static constexpr int DMC_WEIGHT = 110;
+
+static constexpr uint8_t LENGTHS[32] = {
+    10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+    12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30,
+};
+
+// Steps of the duty cycles, from bit 7 on: 12.5%, 25%, 50% and 75% (negated 25%)
+static constexpr uint8_t DUTIES[4] = { 0b01000000, 0b01100000, 0b01111000, 0b10011111 };
+
+// NTSC periods in CPU cycles
+static constexpr uint16_t NOISE_PERIODS[16] = {
+    4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068,
+};
+static constexpr uint16_t DMC_PERIODS[16] = {
+    428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54,
+};
+
+// Frame counter steps, in CPU cycles from the start of the sequence, and what they clock
+enum {
+    QUARTER = BIT_0, // Envelopes and the triangle's linear counter
+    HALF = BIT_1, // Length counters and sweeps
+    FRAME_IRQ = BIT_2,
+};
+static constexpr uint32_t STEP_CYCLES[2][5] = {
+    { 7457, 14913, 22371, 29829 },
+    { 7457, 14913, 22371, 29829, 37281 },
+};
+static constexpr uint8_t STEP_CLOCKS[2][5] = {
+    { QUARTER, QUARTER | HALF, QUARTER, QUARTER | HALF | FRAME_IRQ },
+    { QUARTER, QUARTER | HALF, QUARTER, 0, QUARTER | HALF },
+};
+static constexpr uint8_t STEPS[2] = { 4, 5 };
+static constexpr uint32_t SEQUENCE_CYCLES[2] = { 29830, 37282 };
+
+void APU::Envelope::clock() {
+    if (start) {
+        start = false;
+        decay = 15;
+        divider = volume;
+    } else if (divider) {
+        --divider;
+    } else {
+        divider = volume;
+        if (decay) {
+            --decay;
+        } else if (loop) {
+            decay = 15;
+        }
+    }
+}
+
+int APU::Pulse::level() const {
+    return length && !muted() && DUTIES[duty] >> (7 - step) & 1 ? envelope.level() : 0;
+}
+
+void APU::Pulse::sweep() {
+    if (!sweep_divider && sweep_enabled && sweep_shift && !muted()) period = target();
+    if (!sweep_divider || sweep_reload) {
+        sweep_divider = sweep_period;
+        sweep_reload = false;
+    } else {
+        --sweep_divider;
+    }
+}
+
+APU::APU() {
+    set_sample_rate(44100);
+    reset(0);
+}
+
+void APU::reset(const uint64_t time) {
+    pulses[0] = {};
+    pulses[1] = {};
+    triangle = {};
+    noise = {};
+    dmc = {};
+    pulses[0].complement = 1;
+    noise.shift = 1;
+    noise.period = NOISE_PERIODS[0];
+    dmc.period = DMC_PERIODS[0];
+    dmc.bits = 8;
+    dmc.silence = true;
+    pulses[0].next = pulses[1].next = triangle.next = noise.next = dmc.next = time + 1;
+
+    clock = time;
+    frame_start = time;
+    output.clear();
+    frame_irq = false;
+    write(time, 0x4017, 0);
+}
+
+void APU::write(const uint64_t time, const uint16_t address, const uint8_t value) {
+    // Lands at clock, which is time unless an event already ran the APU past it
+    run(time);
+
+    switch (address) {
+        case 0x4000:
+        case 0x4004: {
+            Pulse &pulse = pulses[address >> 2 & 1];
+            pulse.duty = value >> 6;
+            pulse.envelope.loop = value & BIT_5;
+            pulse.envelope.constant = value & BIT_4;
+            pulse.envelope.volume = value & 0x0F;
+            break;
+        }
+        case 0x4001:
+        case 0x4005: {
+            Pulse &pulse = pulses[address >> 2 & 1];
+            pulse.sweep_enabled = value & BIT_7;
+            pulse.sweep_period = value >> 4 & 7;
+            pulse.sweep_negate = value & BIT_3;
+            pulse.sweep_shift = value & 7;
+            pulse.sweep_reload = true;
+            break;
+        }
+        case 0x4002:
+        case 0x4006: {
+            Pulse &pulse = pulses[address >> 2 & 1];
+            pulse.period = pulse.period & 0x700 | value;
+            break;
+        }
+        case 0x4003:
+        case 0x4007: {
+            Pulse &pulse = pulses[address >> 2 & 1];
+            pulse.period = pulse.period & 0xFF | (value & 7) << 8;
+            if (pulse.enabled) pulse.length = LENGTHS[value >> 3];
+            pulse.step = 0;
+            pulse.envelope.start = true;
+            break;
+        }
+        case 0x4008:
+            triangle.control = value & BIT_7;
+            triangle.linear_period = value & 0x7F;
+            break;
+        case 0x400A:
+            triangle.period = triangle.period & 0x700 | value;
+            break;
+        case 0x400B:
+            triangle.period = triangle.period & 0xFF | (value & 7) << 8;
+            if (triangle.enabled) triangle.length = LENGTHS[value >> 3];
+            triangle.linear_reload = true;
+            break;
+        case 0x400C:
+            noise.envelope.loop = value & BIT_5;
+            noise.envelope.constant = value & BIT_4;
+            noise.envelope.volume = value & 0x0F;
+            break;
+        case 0x400E:
+            noise.short_mode = value & BIT_7;
+            noise.period = NOISE_PERIODS[value & 0x0F];
+            break;
+        case 0x400F:
+            if (noise.enabled) noise.length = LENGTHS[value >> 3];
+            noise.envelope.start = true;
+            break;
+        case 0x4010:
+            dmc.irq_enabled = value & BIT_7;
+            dmc.loop = value & BIT_6;
+            dmc.period = DMC_PERIODS[value & 0x0F];
+            if (!dmc.irq_enabled) dmc.irq = false;
+            break;
+        case 0x4011:
+            dmc.level = value & 0x7F;
+            break;
+        case 0x4012:
+            dmc.start = 0xC000 | value << 6;
+            break;
+        case 0x4013:
+            dmc.length = (value << 4) + 1;
+            break;
+        case 0x4015:
+            pulses[0].enabled = value & BIT_0;
+            pulses[1].enabled = value & BIT_1;
+            triangle.enabled = value & BIT_2;
+            noise.enabled = value & BIT_3;
+            if (!pulses[0].enabled) pulses[0].length = 0;
+            if (!pulses[1].enabled) pulses[1].length = 0;
+            if (!triangle.enabled) triangle.length = 0;
+            if (!noise.enabled) noise.length = 0;
+
+            dmc.irq = false;
+            if (!(value & BIT_4)) {
+                dmc.bytes = 0;
+            } else if (!dmc.bytes) {
+                dmc.restart();
+                fetch();
+            }
+            break;
+        case 0x4017:
+            // The sequence restarts 3 or 4 cycles later, depending on the APU cycle the write lands on. The
+            // 5-step one clocks everything at once.
+            five_step = value & BIT_7;
+            irq_inhibit = value & BIT_6;
+            if (irq_inhibit) frame_irq = false;
+            sequence_origin = clock + (clock & 1 ? 4 : 3);
+            step_index = 0;
+            next_step = sequence_origin + STEP_CYCLES[five_step][0];
+            if (five_step) {
+                quarter_frame();
+                half_frame();
+            }
+            break;
+    }
+    update(clock);
+}
+
+uint8_t APU::read_status(const uint64_t time) {
+    run(time);
+    const uint8_t status = (pulses[0].length ? BIT_0 : 0) | (pulses[1].length ? BIT_1 : 0) |
+                           (triangle.length ? BIT_2 : 0) | (noise.length ? BIT_3 : 0) | (dmc.bytes ? BIT_4 : 0) |
+                           (frame_irq ? BIT_6 : 0) | (dmc.irq ? BIT_7 : 0);
+    frame_irq = false;
+    return status;
+}
+
+void APU::run(const uint64_t time) {
+    while (clock < time) {
+        // Up to the next frame counter step and the end of the output frame at most, which both stop here
+        const uint64_t until = std::min({ time, next_step, frame_start + MAX_FRAME });
+        run_pulse(pulses[0], until);
+        run_pulse(pulses[1], until);
+        run_triangle(until);
+        run_noise(until);
+        run_dmc(until);
+        clock = until;
+
+        if (until == next_step) frame_step();
+        if (until == frame_start + MAX_FRAME) {
+            if (rate) output.end_frame(MAX_FRAME);
+            frame_start = until;
+        }
+    }
+}
+
+void APU::end_frame(const uint64_t time) {
+    run(time);
+    if (rate) output.end_frame(static_cast<uint32_t>(clock - frame_start));
+    frame_start = clock;
+}
+
+void APU::set_sample_rate(const unsigned rate) {
+    this->rate = rate;
+    if (rate) output.set_rates(CPU_CLOCK, rate * ratio, MAX_FRAME, rate / 4);
+    output.clear();
+}
+
+void APU::set_resampling_ratio(const double ratio) {
+    this->ratio = ratio;
+    if (rate) output.set_rates(CPU_CLOCK, rate * ratio, MAX_FRAME, rate / 4);
+}
+
+uint64_t APU::next_irq() const {
+    uint64_t next = NEVER;
+    if (!five_step && !irq_inhibit && !frame_irq) next = sequence_origin + STEP_CYCLES[0][3];
+
+    // The sample buffer is refilled as the output unit empties it, every 8 steps, the IRQ comes with the last byte
+    if (dmc.irq_enabled && !dmc.loop && !dmc.irq && dmc.bytes && dmc.buffered) {
+        const uint64_t fetch = dmc.next + (dmc.bits - 1) * dmc.period;
+        next = std::min<uint64_t>(next, fetch + (dmc.bytes - 1) * 8u * dmc.period);
+    }
+    return next;
+}
+
+void APU::run_pulse(Pulse &pulse, const uint64_t time) {
+    if (pulse.next > time) return;
+
+    const uint32_t period = (pulse.period + 1) * 2;
+    if (!pulse.length || pulse.muted() || !pulse.envelope.level()) {
+        // Silent whatever the step, only the timer moves
+        const uint64_t steps = (time - pulse.next) / period + 1;
+        pulse.step = (pulse.step + steps) & 7;
+        pulse.next += steps * period;
+        return;
+    }
+
+    const int volume = pulse.envelope.level();
+    const uint8_t duty = DUTIES[pulse.duty];
+    for (; pulse.next <= time; pulse.next += period) {
+        pulse.step = (pulse.step + 1) & 7;
+        add(pulse.amplitude, duty >> (7 - pulse.step) & 1 ? volume : 0, pulse.next, PULSE_WEIGHT);
+    }
+}
+
+void APU::run_triangle(const uint64_t time) {
+    if (triangle.next > time) return;
+
+    const uint32_t period = triangle.period + 1;
+    if (!triangle.running()) {
+        triangle.next += ((time - triangle.next) / period + 1) * period;
+        return;
+    }
+
+    for (; triangle.next <= time; triangle.next += period) {
+        triangle.step = (triangle.step + 1) & 31;
+        add(triangle.amplitude, triangle.level(), triangle.next, TRIANGLE_WEIGHT);
+    }
+}
+
+void APU::run_noise(const uint64_t time) {
+    if (noise.next > time) return;
+
+    const uint32_t period = noise.period;
+    if (!noise.length || !noise.envelope.level()) {
+        // The LFSR isn't clocked while nothing can be heard of it, where it is in the sequence doesn't show
+        noise.next += ((time - noise.next) / period + 1) * period;
+        return;
+    }
+
+    const unsigned tap = noise.short_mode ? 6 : 1;
+    for (; noise.next <= time; noise.next += period) {
+        const uint16_t feedback = (noise.shift ^ noise.shift >> tap) & 1;
+        noise.shift = noise.shift >> 1 | feedback << 14;
+        add(noise.amplitude, noise.level(), noise.next, NOISE_WEIGHT);
+    }
+}
+
+void APU::run_dmc(const uint64_t time) {
+    while (dmc.next <= time) {
+        if (dmc.silence && !dmc.buffered) {
+            // Nothing to play until a sample starts, which runs the DMC first: the bits just count down
+            const uint64_t steps = (time - dmc.next) / dmc.period + 1;
+            dmc.bits = (dmc.bits + 7 - steps % 8) % 8 + 1;
+            dmc.next += steps * dmc.period;
+            return;
+        }
+
+        if (!dmc.silence) {
+            if (dmc.shift & 1) {
+                if (dmc.level <= 125) dmc.level += 2;
+            } else if (dmc.level >= 2) {
+                dmc.level -= 2;
+            }
+            dmc.shift >>= 1;
+            add(dmc.amplitude, dmc.level, dmc.next, DMC_WEIGHT);
+        }
+
+        if (!--dmc.bits) {
+            dmc.bits = 8;
+            dmc.silence = !dmc.buffered;
+            if (dmc.buffered) {
+                dmc.shift = dmc.buffer;
+                dmc.buffered = false;
+                fetch();
+            }
+        }
+        dmc.next += dmc.period;
+    }
+}
+
+void APU::fetch() {
+    if (dmc.buffered || !dmc.bytes) return;
+
+    // The CPU is stalled for up to 4 cycles while the byte is read, that isn't emulated
+    dmc.buffer = memory[dmc.address >> 11][dmc.address & 0x7FF];
+    dmc.buffered = true;
+    dmc.address = (dmc.address + 1) | 0x8000;
+    if (!--dmc.bytes) {
+        if (dmc.loop) {
+            dmc.restart();
+        } else if (dmc.irq_enabled) {
+            dmc.irq = true;
+        }
+    }
+}
+
+void APU::frame_step() {
+    const uint8_t clocks = STEP_CLOCKS[five_step][step_index];
+    if (clocks & QUARTER) quarter_frame();
+    if (clocks & HALF) half_frame();
+    if (clocks & FRAME_IRQ && !irq_inhibit) frame_irq = true;
+    update(next_step);
+
+    if (++step_index == STEPS[five_step]) {
+        step_index = 0;
+        sequence_origin += SEQUENCE_CYCLES[five_step];
+    }
+    next_step = sequence_origin + STEP_CYCLES[five_step][step_index];
+}
+
+void APU::quarter_frame() {
+    pulses[0].envelope.clock();
+    pulses[1].envelope.clock();
+    noise.envelope.clock();
+
+    if (triangle.linear_reload) {
+        triangle.linear = triangle.linear_period;
+    } else if (triangle.linear) {
+        --triangle.linear;
+    }
+    if (!triangle.control) triangle.linear_reload = false;
+}
+
+void APU::half_frame() {
+    for (Pulse &pulse : pulses) {
+        if (pulse.length && !pulse.envelope.loop) --pulse.length;
+        pulse.sweep();
+    }
+    if (triangle.length && !triangle.control) --triangle.length;
+    if (noise.length && !noise.envelope.loop) --noise.length;
+}
+
+void APU::update(const uint64_t time) {
+    add(pulses[0].amplitude, pulses[0].level(), time, PULSE_WEIGHT);
+    add(pulses[1].amplitude, pulses[1].level(), time, PULSE_WEIGHT);
+    add(triangle.amplitude, triangle.level(), time, TRIANGLE_WEIGHT);
+    add(noise.amplitude, noise.level(), time, NOISE_WEIGHT);
+    add(dmc.amplitude, dmc.level, time, DMC_WEIGHT);
+}
+
+}
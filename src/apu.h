@@ -0,0 +1,195 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "blip_buffer.h"
+#include "nes.h"
+
+namespace dendy {
+
+// 2A03 sound: two pulse channels, triangle, noise and DMC, and the frame counter with its IRQ. Nothing runs per
+// cycle: channels are brought up to date only when something needs them (register writes, $4015 reads, the
+// end of an audio frame), going from one timer edge to the next, and every change of their output goes into a
+// BlipBuffer as a step at the cycle it happened. Samples are made from those once a frame.
+class APU {
+public:
+    static constexpr double CPU_CLOCK = 1789772.727; // NTSC, Hz
+    static constexpr uint64_t NEVER = UINT64_MAX;
+
+    // CPU page table DMC fetches its samples through (Console::read_pages)
+    const uint8_t *const *memory = nullptr;
+
+    APU();
+
+    // Power-on state as of the given CPU cycle, $4017 written with 0
+    void reset(uint64_t time);
+
+    // $4000-$4013, $4015 and $4017 as written at a CPU cycle
+    void write(uint64_t time, uint16_t address, uint8_t value);
+
+    // $4015: length counters running, DMC bytes left and the IRQ flags. Clears the frame IRQ flag.
+    uint8_t read_status(uint64_t time);
+
+    // Brings the channels and the frame counter up to the given CPU cycle, including it
+    void run(uint64_t time);
+
+    // IRQ line, the frame counter or DMC flag
+    bool irq() const { return frame_irq || dmc.irq; }
+
+    // CPU cycle the IRQ line goes up next as things stand, NEVER if it won't. Register writes and
+    // read_status() can move it.
+    uint64_t next_irq() const;
+
+    // Runs up to the given CPU cycle and makes the samples of the time since the last call
+    void end_frame(uint64_t time);
+
+    // Output rate in Hz, 0 turns synthesis off (the channels still run for $4015 and the IRQs). Drops the
+    // samples not read yet.
+    void set_sample_rate(unsigned rate);
+    unsigned sample_rate() const { return rate; }
+
+    // Makes ratio times as many samples a second as sample_rate() says, to follow a device whose clock doesn't
+    // quite agree with the console's. From the next frame on, the samples not read yet are kept.
+    void set_resampling_ratio(double ratio);
+
+    // Mono samples made by end_frame() and not read yet, up to a quarter of a second of them are kept
+    size_t samples_available() const { return output.samples_available(); }
+    size_t read_samples(int16_t *out, const size_t count) { return output.read_samples(out, count); }
+
+private:
+    struct Envelope {
+        uint8_t volume; // Constant volume, or the period of the decay
+        bool constant;
+        bool loop; // Also halts the length counter
+        bool start;
+        uint8_t divider;
+        uint8_t decay;
+
+        uint8_t level() const { return constant ? volume : decay; }
+        void clock();
+    };
+
+    struct Pulse {
+        Envelope envelope;
+        uint8_t duty;
+        uint8_t step; // Of the 8 in a duty cycle
+        uint16_t period; // Timer, 11 bits, the sequencer steps every (period + 1) * 2 cycles
+        bool sweep_enabled;
+        bool sweep_negate;
+        bool sweep_reload;
+        uint8_t sweep_period;
+        uint8_t sweep_shift;
+        uint8_t sweep_divider;
+        uint8_t length;
+        bool enabled;
+        uint8_t complement; // Pulse 1 negates the sweep change in one's complement (1), pulse 2 in two's (0)
+        uint64_t next; // Cycle of the next sequencer step
+        int amplitude; // Output as last added to the buffer
+
+        uint16_t target() const {
+            const uint16_t change = period >> sweep_shift;
+            return sweep_negate ? period - change - complement : period + change;
+        }
+        // Periods under 8 and sweeps that would overflow silence the channel, sweeping or not
+        bool muted() const { return period < 8 || target() > 0x7FF; }
+        int level() const;
+        void sweep();
+    };
+
+    struct Triangle {
+        uint8_t linear_period; // Linear counter reload value
+        bool control; // Also halts the length counter
+        bool linear_reload;
+        uint8_t linear;
+        uint16_t period; // The sequencer steps every period + 1 cycles
+        uint8_t step; // Of the 32 in a cycle
+        uint8_t length;
+        bool enabled;
+        uint64_t next;
+        int amplitude;
+
+        // Ultrasonic periods under 2 freeze the sequencer rather than playing a constant level mid-step
+        bool running() const { return length && linear && period >= 2; }
+        int level() const { return step < 16 ? 15 - step : step - 16; }
+    };
+
+    struct Noise {
+        Envelope envelope;
+        bool short_mode; // 93-step sequence
+        uint16_t period; // In cycles
+        uint16_t shift; // 15-bit LFSR
+        uint8_t length;
+        bool enabled;
+        uint64_t next;
+        int amplitude;
+
+        int level() const { return length && !(shift & 1) ? envelope.level() : 0; }
+    };
+
+    struct DMC {
+        bool irq_enabled;
+        bool loop;
+        bool irq;
+        uint16_t period; // In cycles
+        uint8_t level; // 7-bit output
+        uint16_t start; // Sample address and length as $4012 and $4013 set them
+        uint16_t length;
+        uint16_t address; // Sample being played
+        uint16_t bytes; // Left to fetch
+        uint8_t buffer;
+        bool buffered;
+        uint8_t shift;
+        uint8_t bits; // Left in shift, 1-8
+        bool silence;
+        uint64_t next; // Cycle of the next output step
+        int amplitude;
+
+        void restart() {
+            address = start;
+            bytes = length;
+        }
+    };
+
+    void run_pulse(Pulse &pulse, uint64_t time);
+    void run_triangle(uint64_t time);
+    void run_noise(uint64_t time);
+    void run_dmc(uint64_t time);
+
+    // Fills the DMC sample buffer if it is empty and bytes are left, raising the IRQ after the last one
+    void fetch();
+
+    void frame_step();
+    void quarter_frame();
+    void half_frame();
+
+    // Adds the channels' levels that changed since the last call to the output at time
+    void update(uint64_t time);
+
+    void add(int &amplitude, const int level, const uint64_t time, const int weight) {
+        if (level == amplitude) return;
+        if (rate) output.add_delta(static_cast<uint32_t>(time - frame_start), (level - amplitude) * weight);
+        amplitude = level;
+    }
+
+    Pulse pulses[2] = {};
+    Triangle triangle = {};
+    Noise noise = {};
+    DMC dmc = {};
+
+    uint64_t clock = 0; // Cycle everything ran up to, including it
+
+    // Frame counter: the sequence started at origin, the step at index is the next one, due at next_step
+    uint64_t sequence_origin = 0;
+    uint64_t next_step = 0;
+    uint8_t step_index = 0;
+    bool five_step = false;
+    bool irq_inhibit = false;
+    bool frame_irq = false;
+
+    unsigned rate = 0;
+    double ratio = 1;
+    uint64_t frame_start = 0; // Cycle the output frame started at
+    BlipBuffer output;
+};
+
+}
@@ -0,0 +1,61 @@
+#include "audio_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace dendy {
+
+AudioRing::AudioRing(const size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    samples = std::make_unique<int16_t[]>(size);
+    mask = size - 1;
+}
+
+size_t AudioRing::write(const int16_t *samples, const size_t count) {
+    const size_t position = written.load(std::memory_order_relaxed);
+    const size_t room = capacity() - (position - taken.load(std::memory_order_acquire));
+    const size_t fits = std::min(count, room);
+
+    // In up to two pieces, around the end of the buffer
+    const size_t index = position & mask;
+    const size_t first = std::min(fits, capacity() - index);
+    memcpy(&this->samples[index], samples, first * sizeof(int16_t));
+    memcpy(&this->samples[0], samples + first, (fits - first) * sizeof(int16_t));
+    written.store(position + fits, std::memory_order_release);
+
+    if (fits < count) overrun_count.fetch_add(count - fits, std::memory_order_relaxed);
+    return fits;
+}
+
+void AudioRing::drain(const size_t count) const {
+    const size_t position = written.load(std::memory_order_relaxed);
+    for (size_t done = taken.load(std::memory_order_acquire); position - done > count;) {
+        taken.wait(done, std::memory_order_acquire);
+        done = taken.load(std::memory_order_acquire);
+    }
+}
+
+size_t AudioRing::read(int16_t *samples, const size_t count) {
+    const size_t position = taken.load(std::memory_order_relaxed);
+    const size_t available = std::min(count, written.load(std::memory_order_acquire) - position);
+
+    const size_t index = position & mask;
+    const size_t first = std::min(available, capacity() - index);
+    memcpy(samples, &this->samples[index], first * sizeof(int16_t));
+    memcpy(samples + first, &this->samples[0], (available - first) * sizeof(int16_t));
+    taken.store(position + available, std::memory_order_release);
+    if (available) taken.notify_one();
+    return available;
+}
+
+void AudioRing::play(int16_t *samples, const size_t count) {
+    const size_t available = read(samples, count);
+    if (available == count) return;
+
+    // The APU's output has no DC, so silence is 0
+    std::fill(samples + available, samples + count, 0);
+    underrun_count.fetch_add(count - available, std::memory_order_relaxed);
+}
+
+}
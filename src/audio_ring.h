@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace dendy {
+
+// Lock-free single producer, single consumer ring of mono samples: the emulation thread writes a frame of them
+// at a time, an audio device thread takes them out at its own pace. The device never waits for the emulation,
+// and the emulation only does when it asks to with drain(). What doesn't fit is dropped and counted as an
+// overrun, what the device needs and isn't there yet is played as silence and counted as an underrun.
+class AudioRing {
+public:
+    // Rounded up to a power of 2
+    explicit AudioRing(size_t capacity);
+
+    AudioRing(const AudioRing &) = delete;
+    AudioRing &operator=(const AudioRing &) = delete;
+
+    // Producer: returns how many samples fit
+    size_t write(const int16_t *samples, size_t count);
+
+    // Producer: blocks until the consumer has taken the ring down to count samples or fewer
+    void drain(size_t count) const;
+
+    // Consumer: takes up to count samples, returns how many there were
+    size_t read(int16_t *samples, size_t count);
+
+    // Consumer: always fills count samples, for a device that has to play something
+    void play(int16_t *samples, size_t count);
+
+    // Samples in the ring, from either side
+    size_t size() const { return written.load(std::memory_order_acquire) - taken.load(std::memory_order_acquire); }
+
+    size_t capacity() const { return mask + 1; }
+
+    // Samples dropped and samples played as silence so far
+    uint64_t overruns() const { return overrun_count.load(std::memory_order_relaxed); }
+    uint64_t underruns() const { return underrun_count.load(std::memory_order_relaxed); }
+
+private:
+    std::unique_ptr<int16_t[]> samples;
+    size_t mask;
+
+    // Samples written and taken since the start, each only ever stored by its own side. Apart, so the two
+    // threads don't share a cache line.
+    alignas(64) std::atomic<size_t> written { 0 };
+    alignas(64) std::atomic<size_t> taken { 0 };
+    alignas(64) std::atomic<uint64_t> overrun_count { 0 };
+    std::atomic<uint64_t> underrun_count { 0 };
+};
+
+}
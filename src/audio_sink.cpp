@@ -0,0 +1,94 @@
+#include "audio_sink.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace dendy {
+
+// RIFF header of 16-bit mono PCM, the sizes filled in by close()
+static void write_wav_header(FILE *file, const unsigned rate, const uint32_t data_size) {
+    const auto put16 = [file](const uint16_t value) { fputc(value & 0xFF, file); fputc(value >> 8, file); };
+    const auto put32 = [&put16](const uint32_t value) { put16(value & 0xFFFF); put16(value >> 16); };
+
+    fwrite("RIFF", 1, 4, file);
+    put32(36 + data_size);
+    fwrite("WAVEfmt ", 1, 8, file);
+    put32(16);
+    put16(1); // PCM
+    put16(1); // Channels
+    put32(rate);
+    put32(rate * 2); // Bytes a second
+    put16(2); // Bytes a sample
+    put16(16); // Bits a sample
+    fwrite("data", 1, 4, file);
+    put32(data_size);
+}
+
+bool AudioSink::open(AudioRing &ring, const unsigned rate, const char *pathname) {
+    close();
+    stopping = false;
+    taken = 0;
+    this->rate = rate;
+
+    if (pathname) {
+        file = fopen(pathname, "wb");
+        if (!file) {
+            perror(pathname);
+            return false;
+        }
+        write_wav_header(file, rate, 0);
+        thread = std::thread([this, &ring] { record(ring); });
+    } else {
+        thread = std::thread([this, &ring] { play(ring); });
+    }
+    return true;
+}
+
+void AudioSink::close() {
+    if (!thread.joinable()) return;
+    stopping.store(true, std::memory_order_release);
+    thread.join();
+
+    if (file) {
+        const uint64_t size = std::min<uint64_t>(samples() * 2, UINT32_MAX - 36);
+        fseek(file, 0, SEEK_SET);
+        write_wav_header(file, rate, static_cast<uint32_t>(size));
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void AudioSink::play(AudioRing &ring) {
+    using clock = std::chrono::steady_clock;
+
+    const size_t period = std::max(1u, rate / 100);
+    const auto duration = std::chrono::nanoseconds(period * 1000000000ull / rate);
+    std::unique_ptr<int16_t[]> samples = std::make_unique<int16_t[]>(period);
+
+    // Against a deadline rather than sleeping a period each time, so late wakeups don't add up
+    auto deadline = clock::now();
+    while (!stopping.load(std::memory_order_acquire)) {
+        ring.play(samples.get(), period);
+        taken.fetch_add(period, std::memory_order_relaxed);
+        deadline += duration;
+        std::this_thread::sleep_until(deadline);
+    }
+}
+
+void AudioSink::record(AudioRing &ring) {
+    int16_t samples[4096];
+    for (;;) {
+        // Whatever was written before close() is in the ring by the time it says so
+        const bool last = stopping.load(std::memory_order_acquire);
+        while (const size_t count = ring.read(samples, std::size(samples))) {
+            fwrite(samples, sizeof(int16_t), count, file);
+            taken.fetch_add(count, std::memory_order_relaxed);
+        }
+        if (last) break;
+
+        // Frames come every 16.6 ms, there's no hurry
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+}
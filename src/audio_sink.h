@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+#include "audio_ring.h"
+
+namespace dendy {
+
+// Takes samples out of an AudioRing on a thread of its own where there is no sound card. Without a file it is
+// a null device: it takes 10 ms of samples every 10 ms in real time, so the ring fills, drains, underruns and
+// overruns as it would with a real one. With a file it writes everything that comes into a WAV
+// as soon as it comes, for headless runs to listen to or compare.
+class AudioSink {
+public:
+    AudioSink() = default;
+    ~AudioSink() { close(); }
+
+    AudioSink(const AudioSink &) = delete;
+    AudioSink &operator=(const AudioSink &) = delete;
+
+    // Starts taking samples of the given rate out of ring, into a WAV file if pathname isn't null. False if the
+    // file can't be created.
+    bool open(AudioRing &ring, unsigned rate, const char *pathname = nullptr);
+
+    // Stops the thread, after writing what's still in the ring to the file, and finishes the file
+    void close();
+
+    // Samples taken out of the ring
+    uint64_t samples() const { return taken.load(std::memory_order_relaxed); }
+
+private:
+    void play(AudioRing &ring);
+    void record(AudioRing &ring);
+
+    FILE *file = nullptr;
+    unsigned rate = 0;
+    std::thread thread;
+    std::atomic<bool> stopping { false };
+    std::atomic<uint64_t> taken { 0 };
+};
+
+}
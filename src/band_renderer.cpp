@@ -0,0 +1,99 @@
+#include "band_renderer.h"
+
+#include <cstring>
+
+namespace dendy {
+
+void RecordedFrame::record(const unsigned scanline, const ScanlineState &state, const PPU &ppu) {
+    if (!memories_count || ppu.memory_writes != recorded_writes) {
+        if (memories.size() == memories_count) memories.emplace_back();
+        ppu.save(memories[memories_count++]);
+        recorded_writes = ppu.memory_writes;
+    }
+    lines[scanline] = state;
+    memory[scanline] = memories_count - 1;
+}
+
+void RecordedFrame::clear() {
+    memset(memory, NO_MEMORY, sizeof(memory));
+    memories_count = 0;
+}
+
+BandRenderer::BandRenderer(unsigned threads) {
+    if (!threads) threads = 1;
+
+    for (unsigned i = 0; i < threads; ++i) {
+        bands.push_back(std::make_unique<Band>());
+    }
+    for (unsigned i = 1; i < threads; ++i) {
+        this->threads.emplace_back(&BandRenderer::run, this, i);
+    }
+}
+
+BandRenderer::~BandRenderer() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+void BandRenderer::draw(const RecordedFrame &frame, uint8_t *screen) {
+    this->frame = &frame;
+    this->screen = screen;
+    if (!threads.empty()) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            drawing = size() - 1;
+            ++generation;
+        }
+        wake.notify_all();
+    }
+
+    draw_band(0);
+
+    if (!threads.empty()) {
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [this] { return !drawing; });
+    }
+}
+
+void BandRenderer::draw_band(const unsigned index) {
+    Band &band = *bands[index];
+    const unsigned first = NES_HEIGHT * index / size();
+    const unsigned last = NES_HEIGHT * (index + 1) / size();
+
+    unsigned loaded = RecordedFrame::NO_MEMORY;
+    for (unsigned scanline = first; scanline < last; ++scanline) {
+        const unsigned memory = frame->memory[scanline];
+        if (memory == RecordedFrame::NO_MEMORY) continue;
+
+        if (memory != loaded) {
+            band.ppu.load(frame->memories[memory]);
+            loaded = memory;
+        }
+        band.renderer.render(band.ppu, scanline, frame->lines[scanline], &screen[scanline * NES_WIDTH]);
+    }
+}
+
+void BandRenderer::run(const unsigned index) {
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        wake.wait(guard, [this, seen] { return generation != seen || stopping; });
+        if (stopping) return;
+        seen = generation;
+
+        guard.unlock();
+        draw_band(index);
+        guard.lock();
+
+        if (!--drawing) done.notify_one();
+    }
+}
+
+}
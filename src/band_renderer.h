@@ -0,0 +1,79 @@
+#pragma once
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "nes.h"
+#include "ppu.h"
+#include "renderer.h"
+
+namespace dendy {
+
+// A frame as the CPU thread left it for drawing elsewhere: the ScanlineState of every line and copies of the
+// PPU memory they are drawn from, a new copy only when that memory was written since the line before
+struct RecordedFrame {
+    static constexpr uint8_t NO_MEMORY = 0xFF;
+
+    ScanlineState lines[NES_HEIGHT];
+    uint8_t memory[NES_HEIGHT]; // Copy in memories each line is drawn from, NO_MEMORY if it wasn't recorded
+    std::vector<PPUMemory> memories; // Kept between frames, so they aren't allocated again
+    unsigned memories_count = 0;
+    uint8_t palette[32] = { 0 }; // PPU::PALETTE and mask at vblank
+    uint8_t mask = 0;
+
+    RecordedFrame() { clear(); }
+
+    // A line, as it would be drawn now
+    void record(unsigned scanline, const ScanlineState &state, const PPU &ppu);
+
+    void clear();
+
+private:
+    uint32_t recorded_writes = 0; // PPU::memory_writes as of the last copy
+};
+
+// Draws recorded frames split into bands of lines, one per thread, each into its own slice of the screen. Every
+// band has a PPU to load the frame's memory into and a Renderer, the same code that draws lines one at a time,
+// so the result is the same byte for byte whatever the number of threads.
+class BandRenderer {
+public:
+    // The calling thread draws the first band, threads - 1 more are started for the others
+    explicit BandRenderer(unsigned threads = 1);
+    ~BandRenderer();
+
+    BandRenderer(const BandRenderer &) = delete;
+    BandRenderer &operator=(const BandRenderer &) = delete;
+
+    // Draws the recorded lines into screen (NES_WIDTH * NES_HEIGHT), the others are left as they are
+    void draw(const RecordedFrame &frame, uint8_t *screen);
+
+    unsigned size() const { return static_cast<unsigned>(bands.size()); }
+
+private:
+    struct Band {
+        PPU ppu;
+        Renderer renderer;
+    };
+
+    void draw_band(unsigned index);
+
+    void run(unsigned index);
+
+    std::vector<std::unique_ptr<Band>> bands;
+    std::vector<std::thread> threads;
+
+    // Frame being drawn, handed to the threads by bumping generation
+    const RecordedFrame *frame = nullptr;
+    uint8_t *screen = nullptr;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned generation = 0;
+    unsigned drawing = 0; // Bands of other threads not finished yet
+    bool stopping = false;
+};
+
+}
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../console.h"
+#include "../input_script.h"
+#include "thread_pool.h"
+
+using namespace dendy;
+using Clock = std::chrono::steady_clock;
+
+// Run consoles on the block translator, see Console::use_jit()
+static bool use_jit = false;
+
+// Draw only the last frame of each job, see Console::set_render_skip()
+static bool skip_render = false;
+
+// Draw frames on a thread of their own per job, see Console::use_pipeline()
+static bool use_pipeline = false;
+
+// Frames a worker runs before handing the job back to its deque, small enough for idle workers to steal work
+#define FRAMES_PER_SLICE 60
+
+struct Job {
+    std::string rom;
+    std::string input;
+    unsigned frames = 0;
+
+    std::unique_ptr<Console> console;
+    input_script_t script = {};
+    unsigned frame = 0;
+
+    Clock::time_point start;
+    Clock::time_point end;
+    Clock::duration busy {};
+    uint32_t hash = 0;
+    double idle = 0; // Share of CPU cycles skipped in idle loops
+    bool failed = false;
+};
+
+// FNV-1a over the final frame and work RAM, enough to spot regressions between runs
+static uint32_t state_hash(const Console &console) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < NES_WIDTH * NES_HEIGHT; ++i) hash = (hash ^ console.SCREEN[i]) * 16777619u;
+    for (const uint8_t byte : console.RAM) hash = (hash ^ byte) * 16777619u;
+    return hash;
+}
+
+static bool start_job(Job &job) {
+    job.start = Clock::now();
+    job.console = std::make_unique<Console>();
+
+    if (!job.console->load(job.rom.c_str()))
+        return false;
+    if (use_jit && !job.console->use_jit(true))
+        return false;
+    job.console->use_pipeline(use_pipeline);
+    if (!job.input.empty() && !input_script_load(&job.script, job.input.c_str()))
+        return false;
+
+    job.console->reset();
+    return true;
+}
+
+static void finish_job(Job &job) {
+    if (!job.failed) {
+        job.console->use_pipeline(false); // Takes the last frame
+        const M6502 &cpu = job.console->cpu;
+        job.hash = state_hash(*job.console);
+        job.idle = cpu.Clock ? static_cast<double>(cpu.IdleSkipped) / cpu.Clock : 0;
+    }
+    input_script_free(&job.script);
+    job.console.reset();
+    job.end = Clock::now();
+}
+
+static void step_job(ThreadPool &pool, Job &job) {
+    const Clock::time_point slice_start = Clock::now();
+
+    if (!job.console && !start_job(job)) {
+        job.failed = true;
+        finish_job(job);
+        return;
+    }
+
+    Console &console = *job.console;
+    const unsigned last_frame = std::min(job.frame + FRAMES_PER_SLICE, job.frames);
+    for (; job.frame < last_frame; ++job.frame) {
+        if (skip_render) console.set_render_skip(job.frame + 1 < job.frames);
+        console.set_buttons(input_script_buttons(&job.script, job.frame));
+        console.frame();
+    }
+    job.busy += Clock::now() - slice_start;
+
+    if (job.frame < job.frames) {
+        pool.submit([&pool, &job] { step_job(pool, job); });
+    } else {
+        finish_job(job);
+    }
+}
+
+// Jobs file: one "<rom> <frames> [input_script]" per line, '#' starts a comment
+static bool load_jobs(const char *pathname, std::vector<Job> &jobs) {
+    FILE *file = fopen(pathname, "r");
+    if (!file) {
+        fprintf(stderr, "Can't open jobs file %s\n", pathname);
+        return false;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        const char *rom = strtok(line, " \t\r\n");
+        if (!rom || *rom == '#') continue;
+
+        const char *frames = strtok(nullptr, " \t\r\n");
+        const char *input = strtok(nullptr, " \t\r\n");
+
+        Job &job = jobs.emplace_back();
+        job.rom = rom;
+        job.frames = frames ? strtoul(frames, nullptr, 10) : 0;
+        if (input && *input != '#') job.input = input;
+    }
+    fclose(file);
+    return true;
+}
+
+static double milliseconds(const Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+int main(int argc, char **argv) {
+    for (; argc > 1 && !strncmp(argv[1], "--", 2); --argc, ++argv) {
+        if (!strcmp(argv[1], "--jit")) {
+            use_jit = true;
+        } else if (!strcmp(argv[1], "--skip-render")) {
+            skip_render = true;
+        } else if (!strcmp(argv[1], "--pipeline")) {
+            use_pipeline = true;
+        } else {
+            printf("Unknown option %s\n", argv[1]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc < 2) {
+        printf("Usage: dendy-batch [--jit] [--skip-render] [--pipeline] <jobs.txt> [threads]\n");
+        printf("jobs.txt: one \"<rom> <frames> [input_script]\" per line\n");
+        printf("--jit runs the CPU on the x86-64 block translator, when built in\n");
+        printf("--skip-render draws only the last frame of each job, the hashes stay the same\n");
+        printf("--pipeline draws each job's frames on a thread of its own while its CPU runs the next one\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Job> jobs;
+    if (!load_jobs(argv[1], jobs))
+        return EXIT_FAILURE;
+
+    const unsigned threads = argc > 2 ? strtoul(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+
+    const Clock::time_point start = Clock::now();
+    {
+        ThreadPool pool(threads);
+        for (Job &job : jobs) {
+            pool.submit([&pool, &job] { step_job(pool, job); });
+        }
+        pool.wait();
+    }
+    const Clock::duration elapsed = Clock::now() - start;
+
+    uint64_t total_frames = 0;
+    int failed = 0;
+
+    printf("%-4s %-32s %8s %10s %10s %10s %6s %8s\n", "job", "rom", "frames", "wall_ms", "busy_ms", "fps", "idle%",
+           "hash");
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const Job &job = jobs[i];
+        const char *name = strrchr(job.rom.c_str(), '/');
+        name = name ? name + 1 : job.rom.c_str();
+
+        if (job.failed) {
+            printf("%-4zu %-32.32s %8s\n", i, name, "FAILED");
+            ++failed;
+            continue;
+        }
+
+        const double busy = milliseconds(job.busy);
+        printf("%-4zu %-32.32s %8u %10.1f %10.1f %10.0f %6.1f %08x\n", i, name, job.frames,
+               milliseconds(job.end - job.start), busy, busy > 0 ? job.frames * 1000.0 / busy : 0.0, job.idle * 100,
+               job.hash);
+        total_frames += job.frames;
+    }
+
+    const double total = milliseconds(elapsed);
+    printf("\n%zu jobs, %llu frames on %u threads in %.1f ms: %.0f frames/sec\n", jobs.size(),
+           (unsigned long long) total_frames, threads ? threads : 1, total, total > 0 ? total_frames * 1000.0 / total : 0.0);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "thread_pool.h"
+
+namespace dendy {
+
+// Worker identity of the calling thread, so tasks can resubmit to their own deque
+static thread_local ThreadPool *current_pool = nullptr;
+static thread_local unsigned current_index = 0;
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (!threads) threads = 1;
+
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        this->threads.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        stopping = true;
+    }
+    idle.notify_all();
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    const unsigned index = current_pool == this ? current_index : next_worker++ % size();
+
+    ++pending;
+    ++queued;
+    {
+        Worker &worker = *workers[index];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.tasks.push_back(std::move(task));
+    }
+
+    std::lock_guard<std::mutex> guard(idle_lock);
+    idle.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> guard(idle_lock);
+    done.wait(guard, [this] { return pending == 0; });
+}
+
+bool ThreadPool::pop(const unsigned index, Task &task) {
+    Worker &worker = *workers[index];
+    std::lock_guard<std::mutex> guard(worker.lock);
+    if (worker.tasks.empty()) return false;
+
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    --queued;
+    return true;
+}
+
+bool ThreadPool::steal(const unsigned index, Task &task) {
+    for (unsigned i = 1; i < size(); ++i) {
+        Worker &victim = *workers[(index + i) % size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (victim.tasks.empty()) continue;
+
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        --queued;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(const unsigned index) {
+    current_pool = this;
+    current_index = index;
+
+    Task task;
+    for (;;) {
+        if (pop(index, task) || steal(index, task)) {
+            task();
+            task = nullptr;
+
+            if (--pending == 0) {
+                std::lock_guard<std::mutex> guard(idle_lock);
+                done.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(idle_lock);
+        idle.wait(guard, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) return;
+    }
+}
+
+}
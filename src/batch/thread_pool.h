@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dendy {
+
+// Work-stealing pool: every worker owns a deque, runs its own tasks newest-first (the console it just
+// stepped is still in cache) and steals the oldest task from another worker when its deque runs dry.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit ThreadPool(unsigned threads);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // From a worker the task goes to that worker's deque, otherwise workers are filled round-robin
+    void submit(Task task);
+
+    // Blocks until every submitted task, including ones submitted by tasks, has finished
+    void wait();
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    bool pop(unsigned index, Task &task);
+
+    bool steal(unsigned index, Task &task);
+
+    void run(unsigned index);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex idle_lock;
+    std::condition_variable idle;
+    std::condition_variable done;
+    std::atomic<size_t> queued { 0 };
+    std::atomic<size_t> pending { 0 };
+    std::atomic<unsigned> next_worker { 0 };
+    bool stopping = false;
+};
+
+}
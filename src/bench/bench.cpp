@@ -0,0 +1,488 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "../band_renderer.h"
+#include "../console.h"
+#include "../input_script.h"
+#include "../screen_converter.h"
+#include "../tile_row.h"
+
+using namespace dendy;
+using Clock = std::chrono::steady_clock;
+
+// Runs of each dispatcher per ROM, the fastest one is reported
+#define RUNS 3
+
+struct Dispatcher {
+    const char *name;
+    void (*setup)(Console &console); // Selects the dispatcher on a console with a ROM inserted
+};
+
+static const Dispatcher dispatchers[] = {
+#ifdef THREADED_DISPATCH
+    { "switch", [](Console &console) { console.exec = ExecSwitch6502; } },
+    { "threaded", [](Console &console) {} },
+#else
+    { "switch", [](Console &console) {} },
+#endif
+#ifdef DENDY_JIT
+    { "jit", [](Console &console) { console.use_jit(true); } },
+#endif
+};
+
+struct Result {
+    double seconds = 0;
+    double cpu_seconds = 0;
+    unsigned long long instructions = 0;
+    double idle = 0; // Share of cycles skipped in idle loops
+    uint32_t hash = 0;
+};
+
+// FNV-1a over the final frame and work RAM, all dispatchers must end up in the same state
+static uint32_t state_hash(const Console &console) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < NES_WIDTH * NES_HEIGHT; ++i) hash = (hash ^ console.SCREEN[i]) * 16777619u;
+    for (const uint8_t byte : console.RAM) hash = (hash ^ byte) * 16777619u;
+    return hash;
+}
+
+// Dispatcher under test and the time spent in it, so MIPS leaves rendering out
+static int (*timed)(M6502 *R, int cycles);
+static Clock::duration cpu_time;
+
+static int timed_exec(M6502 *R, const int cycles) {
+    const Clock::time_point start = Clock::now();
+    const int left = timed(R, cycles);
+    cpu_time += Clock::now() - start;
+    return left;
+}
+
+static bool run(const std::shared_ptr<const RomImage> &rom, const unsigned frames, const Dispatcher &dispatcher,
+                Result &result) {
+    for (unsigned i = 0; i < RUNS; ++i) {
+        const auto console = std::make_unique<Console>();
+        if (!console->insert(rom))
+            return false;
+        dispatcher.setup(*console);
+        timed = console->exec;
+        cpu_time = {};
+        console->exec = timed_exec;
+        console->reset();
+
+        const Clock::time_point start = Clock::now();
+        for (unsigned frame = 0; frame < frames; ++frame) {
+            console->frame();
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        if (!i || seconds < result.seconds) result.seconds = seconds;
+        const double cpu_seconds = std::chrono::duration<double>(cpu_time).count();
+        if (!i || cpu_seconds < result.cpu_seconds) result.cpu_seconds = cpu_seconds;
+        result.instructions = console->cpu.Executed;
+        result.idle = console->cpu.Clock ? static_cast<double>(console->cpu.IdleSkipped) / console->cpu.Clock : 0;
+        result.hash = state_hash(*console);
+    }
+    return true;
+}
+
+// Differences between two consoles that must be in the same state, printed, nothing if they are equal
+static bool differs(const char *what, const uint8_t *a, const uint8_t *b, const size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (a[i] != b[i]) {
+            printf("  %s[$%04zX]: %02X vs %02X\n", what, i, a[i], b[i]);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool differs(const Console &a, const Console &b) {
+    const M6502 &x = a.cpu, &y = b.cpu;
+    if (x.A != y.A || x.P != y.P || x.X != y.X || x.Y != y.Y || x.S != y.S || x.PC.W != y.PC.W ||
+        x.ICount != y.ICount || x.IRequest != y.IRequest || x.AfterCLI != y.AfterCLI || x.Executed != y.Executed) {
+        for (const M6502 *cpu : { &x, &y }) {
+            printf("  A=%02X P=%02X X=%02X Y=%02X S=%02X PC=%04X ICount=%d IRequest=%04X AfterCLI=%d executed=%llu\n",
+                   cpu->A, cpu->P, cpu->X, cpu->Y, cpu->S, cpu->PC.W, cpu->ICount, cpu->IRequest, cpu->AfterCLI,
+                   cpu->Executed);
+        }
+        return true;
+    }
+    return differs("RAM", a.RAM, b.RAM, sizeof(a.RAM)) || differs("PRGRAM", a.PRGRAM, b.PRGRAM, sizeof(a.PRGRAM)) ||
+           differs("SCREEN", a.SCREEN, b.SCREEN, sizeof(a.SCREEN));
+}
+
+// Runs the translator and the interpreter side by side and stops at the first frame they disagree on
+static int lockstep(const unsigned frames, const char *pathname, const char *input) {
+    const std::shared_ptr<const RomImage> rom = RomImage::load(pathname);
+    input_script_t script = {};
+    if (!rom || input && !input_script_load(&script, input)) {
+        printf("Can't load %s\n", input && rom ? input : pathname);
+        return EXIT_FAILURE;
+    }
+
+    Console translated, interpreted;
+    translated.insert(rom);
+    interpreted.insert(rom);
+    if (!translated.use_jit(true)) {
+        printf("No translator in this build\n");
+        return EXIT_FAILURE;
+    }
+    translated.reset();
+    interpreted.reset();
+
+    for (unsigned frame = 0; frame < frames; ++frame) {
+        const uint8_t buttons = input_script_buttons(&script, frame);
+        for (Console *console : { &translated, &interpreted }) {
+            console->set_buttons(buttons);
+            console->frame();
+        }
+        if (differs(translated, interpreted)) {
+            printf("%s: jit and interpreter differ after frame %u (jit values first)\n", pathname, frame);
+            input_script_free(&script);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("%s: %u frames, %llu instructions, jit and interpreter identical\n", pathname, frames,
+           translated.cpu.Executed);
+    input_script_free(&script);
+    return EXIT_SUCCESS;
+}
+
+// NROM-128 shows its 16K at both $8000 and $C000, so the same PRG bytes run at two CPU addresses: the program
+// calls a subroutine from $C000, then jumps to $8000 and calls it again from the mirror. The return addresses
+// pushed and returned to differ, translated code must not take them over from the other address.
+static int mirrored_lockstep() {
+    static const uint8_t code[] = {
+        0x78, 0xD8, 0xA2, 0xFF, 0x9A, // SEI, CLD, LDX #$FF, TXS
+        0x20, 0x10, 0xC0,             // JSR $C010
+        0x4C, 0x00, 0x80,             // JMP $8000
+    };
+    std::vector<uint8_t> image(16 + 0x4000 + 0x2000);
+    memcpy(image.data(), "NES\x1A\x01\x01", 6);
+    uint8_t *const prg = &image[16];
+    memcpy(prg, code, sizeof(code));
+    prg[0x10] = 0xE6; // INC $00
+    prg[0x12] = 0x60; // RTS
+    prg[0x20] = 0x40; // RTI
+    static const uint8_t vectors[] = { 0x20, 0xC0, 0x00, 0xC0, 0x20, 0xC0 };
+    memcpy(&prg[0x3FFA], vectors, sizeof(vectors));
+
+    char pathname[] = "/tmp/dendy-mirrored-XXXXXX.nes";
+    const int fd = mkstemps(pathname, 4);
+    FILE *file = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+    if (!file || fwrite(image.data(), 1, image.size(), file) != image.size()) {
+        printf("Can't write %s\n", pathname);
+        if (file) fclose(file);
+        return EXIT_FAILURE;
+    }
+    fclose(file);
+
+    const int result = lockstep(60, pathname, nullptr);
+    unlink(pathname);
+    return result;
+}
+
+// The decoded tile cache must follow CHR-RAM written while its bank is switched out of the slot it was decoded
+// for, then switched back in
+static bool tile_cache_follows_banks() {
+    const auto ppu = std::make_unique<PPU>();
+    const uint8_t *banks[8];
+    for (unsigned slot = 0; slot < 8; ++slot) banks[slot] = &ppu->CHRRAM[slot * 0x400];
+    ppu->map(ppu->CHRRAM, banks, MIRROR_HORIZONTAL);
+    ppu->tiles();
+
+    // Bank 0 leaves slot 0 undecoded, is written through slot 4 ($1000) and comes back
+    banks[0] = &ppu->CHRRAM[0x400];
+    ppu->map(ppu->CHRRAM, banks, MIRROR_HORIZONTAL);
+    banks[4] = &ppu->CHRRAM[0];
+    ppu->map(ppu->CHRRAM, banks, MIRROR_HORIZONTAL);
+    ppu->write(0x2006, 0x10);
+    ppu->write(0x2006, 0x00);
+    ppu->write(0x2007, 0xFF);
+    banks[0] = &ppu->CHRRAM[0];
+    ppu->map(ppu->CHRRAM, banks, MIRROR_HORIZONTAL);
+
+    // Row 0 of tile 0 is colour 1 in both slots
+    const Tile *tiles = ppu->tiles();
+    return tiles[0].pixels[0][0] == 1 && tiles[256].pixels[0][0] == 1;
+}
+
+// Times the background tile expanders on random rows, each must match the scalar reference byte for byte
+static int tiles(const unsigned rows) {
+    std::vector<TileRow> input(256, TileRow {});
+    uint32_t seed = 1;
+    for (TileRow &row : input) {
+        for (unsigned tile = 0; tile < TileRow::TILES; ++tile) {
+            seed = seed * 1664525 + 1013904223;
+            row.low[tile] = seed >> 24;
+            row.high[tile] = seed >> 16;
+            row.palette[tile] = (seed >> 8 & 3) << 2;
+        }
+    }
+
+    int failed = 0;
+    if (!tile_cache_follows_banks()) {
+        printf("tile cache keeps CHR-RAM patterns written while switched out\n");
+        ++failed;
+    }
+
+    uint8_t reference[TileRow::PADDED * 8], pixels[TileRow::PADDED * 8];
+    const size_t size = TileRow::TILES * 8; // The rest is padding
+    printf("%-8s %10s %12s\n", "expander", "rows", "Mpixels/s");
+    for (size_t i = 0; i < tile_expanders_count; ++i) {
+        const TileExpander &expander = tile_expanders[i];
+        if (!expander.supported()) {
+            printf("%-8s not supported by this CPU\n", expander.name);
+            continue;
+        }
+
+        for (const TileRow &row : input) {
+            tile_expanders[0].expand(row, reference);
+            expander.expand(row, pixels);
+            if (memcmp(reference, pixels, size) != 0) {
+                printf("%-8s differs from %s\n", expander.name, tile_expanders[0].name);
+                ++failed;
+                break;
+            }
+        }
+
+        double best = 0;
+        for (unsigned run = 0; run < RUNS; ++run) {
+            const Clock::time_point start = Clock::now();
+            for (unsigned row = 0; row < rows; ++row) {
+                expander.expand(input[row % input.size()], pixels);
+                asm volatile("" : : "r"(pixels) : "memory"); // Keep the stores
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (!run || seconds < best) best = seconds;
+        }
+        printf("%-8s %10u %12.1f\n", expander.name, rows, rows * size / best / 1e6);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Times converting SCREEN to every pixel format on random frames and palettes, each conversion must match the
+// scalar one of its format byte for byte
+static int convert(const unsigned frames) {
+    static const char *const format_names[] = { "argb8888", "rgb565", "yuv420" };
+
+    std::vector<uint8_t> screens(8 * NES_WIDTH * NES_HEIGHT);
+    uint32_t seed = 1;
+    for (uint8_t &index : screens) {
+        seed = seed * 1664525 + 1013904223;
+        index = seed >> 27;
+    }
+    uint8_t palette[32];
+    for (uint8_t &colour : palette) {
+        seed = seed * 1664525 + 1013904223;
+        colour = seed >> 26;
+    }
+    ScreenConverter converter;
+    converter.set_palette(palette, BIT_5); // Red emphasis
+
+    int failed = 0;
+    std::vector<uint8_t> reference(frame_size(PixelFormat::ARGB8888)), pixels(reference.size());
+    printf("%-8s %-9s %10s %12s\n", "convert", "format", "frames", "Mpixels/s");
+    for (size_t i = 0; i < screen_conversions_count; ++i) {
+        const ScreenConversion &conversion = screen_conversions[i];
+        const char *format = format_names[static_cast<int>(conversion.format)];
+        if (!conversion.supported()) {
+            printf("%-8s %-9s not supported by this CPU\n", conversion.name, format);
+            continue;
+        }
+
+        const convert_screen_fn scalar = screen_conversions[static_cast<int>(conversion.format)].convert;
+        const ScreenColours &colours = converter.colours();
+        for (size_t screen = 0; screen < screens.size(); screen += NES_WIDTH * NES_HEIGHT) {
+            scalar(colours, &screens[screen], reference.data());
+            conversion.convert(colours, &screens[screen], pixels.data());
+            if (memcmp(reference.data(), pixels.data(), frame_size(conversion.format)) != 0) {
+                printf("%-8s %-9s differs from scalar\n", conversion.name, format);
+                ++failed;
+                break;
+            }
+        }
+
+        double best = 0;
+        for (unsigned run = 0; run < RUNS; ++run) {
+            const Clock::time_point start = Clock::now();
+            for (unsigned frame = 0; frame < frames; ++frame) {
+                conversion.convert(colours, &screens[frame % 8 * NES_WIDTH * NES_HEIGHT], pixels.data());
+                asm volatile("" : : "r"(pixels.data()) : "memory"); // Keep the stores
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (!run || seconds < best) best = seconds;
+        }
+        printf("%-8s %-9s %10u %12.1f\n", conversion.name, format, frames,
+               static_cast<double>(frames) * NES_WIDTH * NES_HEIGHT / best / 1e6);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Records frames of a ROM through the render pipeline, then times drawing them with 1 to threads bands; every
+// count must draw the same bytes as one
+static int bands(const unsigned frames, const char *pathname, unsigned threads) {
+    Console console;
+    if (!console.load(pathname)) {
+        printf("Can't load %s\n", pathname);
+        return EXIT_FAILURE;
+    }
+    console.use_pipeline(true);
+    console.reset();
+
+    std::vector<RecordedFrame> recorded;
+    for (unsigned frame = 0; frame < frames; ++frame) {
+        console.frame();
+        recorded.push_back(*console.recorded_frame());
+    }
+
+    if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint8_t> reference(recorded.size() * NES_WIDTH * NES_HEIGHT);
+    std::vector<uint8_t> screens(reference.size());
+
+    int failed = 0;
+    double single = 0;
+    printf("%-8s %8s %10s %10s %8s\n", "threads", "frames", "ms", "fps", "speedup");
+    for (unsigned count = 1; count <= threads; ++count) {
+        BandRenderer renderer(count);
+        std::vector<uint8_t> &output = count == 1 ? reference : screens;
+
+        double best = 0;
+        for (unsigned run = 0; run < RUNS; ++run) {
+            const Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < recorded.size(); ++i) {
+                renderer.draw(recorded[i], &output[i * NES_WIDTH * NES_HEIGHT]);
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (!run || seconds < best) best = seconds;
+        }
+        if (count == 1) single = best;
+
+        printf("%-8u %8zu %10.1f %10.0f %7.2fx\n", count, recorded.size(), best * 1000, recorded.size() / best,
+               single / best);
+        if (count > 1 && screens != reference) {
+            printf("%-8u differs from 1 thread\n", count);
+            ++failed;
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Times frames of a ROM with sound synthesis off and at the usual output rates, read out every frame as a
+// frontend would
+static int audio(const unsigned frames, const char *pathname) {
+    const std::shared_ptr<const RomImage> rom = RomImage::load(pathname);
+    if (!rom) {
+        printf("Can't load %s\n", pathname);
+        return EXIT_FAILURE;
+    }
+
+    double off = 0;
+    printf("%-8s %8s %10s %10s %8s %8s\n", "rate", "frames", "samples", "ms", "fps", "cost%");
+    for (const unsigned rate : { 0u, 44100u, 48000u }) {
+        double best = 0;
+        size_t samples = 0;
+        for (unsigned run = 0; run < RUNS; ++run) {
+            Console console;
+            console.insert(rom);
+            console.apu.set_sample_rate(rate);
+            console.reset();
+
+            int16_t buffer[2048];
+            samples = 0;
+            const Clock::time_point start = Clock::now();
+            for (unsigned frame = 0; frame < frames; ++frame) {
+                console.frame();
+                samples += console.apu.read_samples(buffer, std::size(buffer));
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if (!run || seconds < best) best = seconds;
+        }
+        if (!rate) off = best;
+
+        printf("%-8u %8u %10zu %10.1f %8.0f %7.1f%%\n", rate, frames, samples, best * 1000, frames / best,
+               (best - off) / off * 100);
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(const int argc, char **argv) {
+    if (argc > 3 && !strcmp(argv[1], "--lockstep")) {
+        if (mirrored_lockstep() != EXIT_SUCCESS) return EXIT_FAILURE;
+        return lockstep(strtoul(argv[2], nullptr, 10), argv[3], argc > 4 ? argv[4] : nullptr);
+    }
+    if (argc > 2 && !strcmp(argv[1], "--tiles")) {
+        return tiles(strtoul(argv[2], nullptr, 10));
+    }
+    if (argc > 2 && !strcmp(argv[1], "--convert")) {
+        return convert(strtoul(argv[2], nullptr, 10));
+    }
+    if (argc > 3 && !strcmp(argv[1], "--bands")) {
+        return bands(strtoul(argv[2], nullptr, 10), argv[3], argc > 4 ? strtoul(argv[4], nullptr, 10) : 0);
+    }
+    if (argc > 3 && !strcmp(argv[1], "--audio")) {
+        return audio(strtoul(argv[2], nullptr, 10), argv[3]);
+    }
+    if (argc < 3) {
+        printf("Usage: dendy-bench <frames> <rom> [rom...]\n");
+        printf("       dendy-bench --lockstep <frames> <rom> [input_script]\n");
+        printf("       dendy-bench --tiles <rows>\n");
+        printf("       dendy-bench --bands <frames> <rom> [threads]\n");
+        printf("       dendy-bench --convert <frames>\n");
+        printf("       dendy-bench --audio <frames> <rom>\n");
+        printf("Compares instructions/sec of the 6502 dispatchers built in, no input, best of %d runs.\n", RUNS);
+        printf("--lockstep checks the translator against the interpreter frame by frame, on a built-in image\n");
+        printf("        with mirrored PRG first.\n");
+        printf("--tiles checks the tile cache over CHR-RAM bank switches, and the background tile expanders against\n");
+        printf("        the scalar one, timing them.\n");
+        printf("--bands times drawing recorded frames on 1 to threads bands, checking they all draw the same.\n");
+        printf("--convert checks the SCREEN to pixels conversions against the scalar ones and times them.\n");
+        printf("--audio times frames without sound synthesis and with it at 44.1 and 48 kHz.\n");
+        return EXIT_FAILURE;
+    }
+
+    const unsigned frames = strtoul(argv[1], nullptr, 10);
+    int failed = 0;
+
+    printf("%-32s %-8s %8s %12s %10s %8s %10s %6s %8s\n", "rom", "dispatch", "frames", "instructions", "cpu_ms",
+           "MIPS", "fps", "idle%", "hash");
+    for (int arg = 2; arg < argc; ++arg) {
+        const char *name = strrchr(argv[arg], '/');
+        name = name ? name + 1 : argv[arg];
+
+        const std::shared_ptr<const RomImage> rom = RomImage::load(argv[arg]);
+        Result results[std::size(dispatchers)];
+        for (size_t i = 0; i < std::size(dispatchers); ++i) {
+            if (!run(rom, frames, dispatchers[i], results[i])) {
+                printf("%-32.32s %-8s FAILED\n", name, dispatchers[i].name);
+                ++failed;
+                break;
+            }
+            const Result &result = results[i];
+            printf("%-32.32s %-8s %8u %12llu %10.1f %8.1f %10.0f %6.1f %08x\n", name, dispatchers[i].name, frames,
+                   result.instructions, result.cpu_seconds * 1000, result.instructions / result.cpu_seconds / 1e6,
+                   frames / result.seconds, result.idle * 100, result.hash);
+
+            if (i && result.hash != results[0].hash) {
+                printf("%-32.32s %-8s state differs from %s\n", name, dispatchers[i].name, dispatchers[0].name);
+                ++failed;
+            }
+        }
+        for (size_t i = 1; i < std::size(dispatchers); ++i) {
+            if (results[i].cpu_seconds > 0)
+                printf("%-32.32s %-8s speedup %.2fx\n", name, dispatchers[i].name,
+                       results[0].cpu_seconds / results[i].cpu_seconds);
+        }
+        printf("\n");
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+#include "blip_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dendy {
+
+// Steps are cut off a little below the output Nyquist frequency, at this fraction of it
+static constexpr double CUTOFF = 0.9;
+
+// The integrator leaks 1 / 2^BASS_SHIFT a sample, a high-pass around 14 Hz at 44.1 kHz that keeps DC out
+static constexpr unsigned BASS_SHIFT = 9;
+
+static constexpr int UNIT_BITS = 15;
+
+// Blackman windowed sinc, the impulse response steps are filtered with, x in output samples
+static double impulse(const double x) {
+    const double half = BlipBuffer::TAPS / 2;
+    if (fabs(x) >= half) return 0;
+    const double sinc = x ? sin(M_PI * CUTOFF * x) / (M_PI * CUTOFF * x) : 1;
+    return sinc * (0.42 + 0.5 * cos(M_PI * x / half) + 0.08 * cos(2 * M_PI * x / half));
+}
+
+const std::array<std::array<int32_t, BlipBuffer::TAPS>, BlipBuffer::PHASES> BlipBuffer::kernels = [] {
+    // Samples are summed up, so a tap takes what the filtered step rises by over the sample before it: the
+    // integral of the impulse over that stretch. Centred TAPS / 2 samples late, to the phase after that.
+    constexpr unsigned STEPS = 64;
+    std::array<std::array<int32_t, TAPS>, PHASES> steps {};
+    for (unsigned phase = 0; phase < PHASES; ++phase) {
+        double rise[TAPS];
+        double total = 0;
+        for (unsigned tap = 0; tap < TAPS; ++tap) {
+            const double start = static_cast<double>(tap) - TAPS / 2.0 - static_cast<double>(phase) / PHASES;
+            rise[tap] = 0;
+            for (unsigned step = 0; step < STEPS; ++step) rise[tap] += impulse(start + (step + 0.5) / STEPS);
+            total += rise[tap];
+        }
+
+        // Rounded to sum up to exactly one, the rest goes into the largest tap, so steps leave no DC error behind
+        int32_t sum = 0;
+        unsigned largest = 0;
+        for (unsigned tap = 0; tap < TAPS; ++tap) {
+            steps[phase][tap] = static_cast<int32_t>(lround(rise[tap] / total * (1 << UNIT_BITS)));
+            sum += steps[phase][tap];
+            if (steps[phase][tap] > steps[phase][largest]) largest = tap;
+        }
+        steps[phase][largest] += (1 << UNIT_BITS) - sum;
+    }
+    return steps;
+}();
+
+void BlipBuffer::set_rates(const double clock_rate, const double sample_rate, const uint32_t max_clocks,
+                           const size_t capacity) {
+    factor = static_cast<uint64_t>(sample_rate / clock_rate * 4294967296.0 + 0.5);
+    this->capacity = capacity;
+    buffer.resize(capacity + static_cast<size_t>(max_clocks * sample_rate / clock_rate) + TAPS + 2);
+}
+
+size_t BlipBuffer::end_frame(const uint32_t time) {
+    offset += time * factor;
+    available = offset >> 32;
+    if (available <= capacity) return 0;
+
+    const size_t dropped = available - capacity;
+    remove_samples(dropped);
+    return dropped;
+}
+
+size_t BlipBuffer::read_samples(int16_t *out, size_t count) {
+    count = std::min(count, available);
+    for (size_t i = 0; i < count; ++i) {
+        sum += buffer[i];
+        out[i] = static_cast<int16_t>(std::clamp<int64_t>(sum >> UNIT_BITS, INT16_MIN, INT16_MAX));
+        sum -= sum >> BASS_SHIFT;
+    }
+    // Shifts out what was read
+    const size_t used = std::min(buffer.size(), available + TAPS + 1);
+    std::copy(buffer.begin() + count, buffer.begin() + used, buffer.begin());
+    std::fill(buffer.begin() + used - count, buffer.begin() + used, 0);
+    offset -= static_cast<uint64_t>(count) << 32;
+    available -= count;
+    return count;
+}
+
+void BlipBuffer::remove_samples(const size_t count) {
+    // Read into nowhere, the integrator has to go through them all the same
+    int16_t scratch[256];
+    for (size_t left = std::min(count, available); left;) {
+        left -= read_samples(scratch, std::min(left, std::size(scratch)));
+    }
+}
+
+void BlipBuffer::clear() {
+    std::fill(buffer.begin(), buffer.end(), 0);
+    offset = 0;
+    available = 0;
+    sum = 0;
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dendy {
+
+// Band-limited synthesis of waveforms made of steps, after blargg's Blip_Buffer: a source adds each change of its
+// output as a delta at the clock it happens, spread over TAPS output samples by a windowed sinc step, so nothing
+// above the output Nyquist frequency is left to alias. The deltas are summed up into samples once per frame,
+// there is no work per input clock at all.
+class BlipBuffer {
+public:
+    static constexpr unsigned PHASE_BITS = 5; // Positions between two output samples a step can start at
+    static constexpr unsigned PHASES = 1 << PHASE_BITS;
+    static constexpr unsigned TAPS = 16;
+
+    // Clocks per second in and samples per second out, frames of up to max_clocks and at most capacity samples
+    // kept unread. Changing the rates keeps the samples made so far.
+    void set_rates(double clock_rate, double sample_rate, uint32_t max_clocks, size_t capacity);
+
+    // A step of delta in the output, time in clocks from the start of the frame
+    void add_delta(const uint32_t time, const int delta) {
+        const uint64_t position = offset + time * factor;
+        int32_t *out = &buffer[position >> 32];
+        const int32_t *kernel = kernels[position >> (32 - PHASE_BITS) & (PHASES - 1)].data();
+        for (unsigned tap = 0; tap < TAPS; ++tap) out[tap] += delta * kernel[tap];
+    }
+
+    // Ends the frame after time clocks, the samples it completes can be read from then on. Returns how many of
+    // the oldest were dropped to stay within capacity.
+    size_t end_frame(uint32_t time);
+
+    size_t samples_available() const { return available; }
+
+    // Takes up to count samples, returns how many it took
+    size_t read_samples(int16_t *out, size_t count);
+
+    // Drops up to count of the oldest samples
+    void remove_samples(size_t count);
+
+    void clear();
+
+private:
+    // Windowed sinc steps for each phase, every one adding up to 1 << 15
+    static const std::array<std::array<int32_t, TAPS>, PHASES> kernels;
+
+    uint64_t factor = 0; // Samples per clock, 32.32 fixed point
+    uint64_t offset = 0; // Position the frame starts at in buffer, the same way
+    size_t capacity = 0;
+    std::vector<int32_t> buffer; // Deltas per sample, scaled by the kernels' 1 << 15
+    size_t available = 0;
+    int64_t sum = 0; // Integrator, carried from sample to sample
+};
+
+}
@@ -0,0 +1,41 @@
+#include "compositor.h"
+
+// SSE2 is always there on x86-64
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+namespace dendy {
+
+#if defined(__x86_64__)
+void compose_line(const LineBuffers &line, uint8_t *screen) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i colour = _mm_set1_epi8(3);
+
+    for (unsigned x = 0; x < NES_WIDTH; x += 16) {
+        const __m128i background = _mm_load_si128(reinterpret_cast<const __m128i *>(&line.background[x]));
+        const __m128i sprites = _mm_load_si128(reinterpret_cast<const __m128i *>(&line.sprites[x]));
+        const __m128i behind = _mm_load_si128(reinterpret_cast<const __m128i *>(&line.behind[x]));
+
+        const __m128i background_clear = _mm_cmpeq_epi8(_mm_and_si128(background, colour), zero);
+        const __m128i sprites_clear = _mm_cmpeq_epi8(sprites, zero);
+
+        // Hidden sprite pixels: transparent ones, and those behind an opaque background
+        const __m128i hidden = _mm_or_si128(sprites_clear, _mm_andnot_si128(background_clear, behind));
+        const __m128i visible_background = _mm_andnot_si128(background_clear, background);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&screen[x]),
+                         _mm_or_si128(_mm_andnot_si128(hidden, sprites), _mm_and_si128(hidden, visible_background)));
+    }
+}
+#else
+void compose_line(const LineBuffers &line, uint8_t *screen) {
+    for (unsigned x = 0; x < NES_WIDTH; ++x) {
+        const uint8_t background = line.background[x] & 3 ? line.background[x] : 0;
+        const bool hidden = !line.sprites[x] || line.behind[x] && background;
+        screen[x] = hidden ? background : line.sprites[x];
+    }
+}
+#endif
+
+}
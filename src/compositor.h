@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+
+#include "nes.h"
+
+namespace dendy {
+
+// Layers of one scanline, NES_WIDTH pixels each, merged into SCREEN by compose_line()
+struct LineBuffers {
+    alignas(16) uint8_t background[NES_WIDTH]; // Background palette indexes, transparent where bits 0-1 are 0
+    alignas(16) uint8_t sprites[NES_WIDTH]; // Sprite palette indexes ($10-$1F), 0 where no sprite is opaque
+    alignas(16) uint8_t behind[NES_WIDTH]; // $FF where that sprite pixel has priority behind the background
+};
+
+// Picks the visible pixel of each: a sprite in front, or behind a transparent background, else the background,
+// and the backdrop (0) where both are transparent
+void compose_line(const LineBuffers &line, uint8_t *screen);
+
+}
@@ -0,0 +1,462 @@
+#pragma GCC push_options
+#pragma GCC optimize ("unroll-loops")
+
+#include "console.h"
+#include "tile_row.h"
+#ifdef DENDY_JIT
+#include "jit.h"
+#else
+namespace dendy { class Jit {}; } // Never created without the translator, just completes std::unique_ptr<Jit>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+namespace dendy {
+
+// Unmapped reads return $FF. constexpr, so it is ready before any static Console is constructed
+static constexpr std::array<uint8_t, 0x800> open_bus = [] {
+    std::array<uint8_t, 0x800> page {};
+    page.fill(0xFF);
+    return page;
+}();
+
+static constexpr int64_t FRAME_DOTS = NTSC_SCANLINES_PER_FRAME * PPU_DOTS_PER_SCANLINE;
+static constexpr int64_t A12_RISES_PER_FRAME = VISIBLE_SCANLINES + 1; // Pre-render line included
+
+Console::Console() {
+    sprite0_line_event = scheduler.add([this](const uint64_t time) { catch_up(time); });
+    overflow_line_event = scheduler.add([this](const uint64_t time) { catch_up(time); });
+    vblank_event = scheduler.add([this](const uint64_t time) { start_vblank(time); });
+    prerender_event = scheduler.add([this](const uint64_t time) { end_vblank(time); });
+    sprite0_event = scheduler.add([this](uint64_t) { ppu.status |= BIT_6; });
+    apu_event = scheduler.add([this](const uint64_t time) {
+        apu.run(time);
+        update_irq();
+    });
+    mapper_event = scheduler.add([this](const uint64_t time) {
+        run_scanline_counter(time);
+        update_irq();
+    });
+
+    cpu.User = this;
+    cpu.Page = read_pages;
+    cpu.Decoded = decoded_pages;
+    apu.memory = read_pages;
+    map_memory();
+}
+
+Console::~Console() = default;
+
+bool Console::use_jit(const bool enabled) {
+    exec = Exec6502;
+    jit.reset();
+#ifdef DENDY_JIT
+    if (enabled && rom) {
+        jit = std::make_unique<Jit>(rom);
+        exec = exec_jit;
+        return true;
+    }
+#endif
+    return !enabled;
+}
+
+void Console::use_pipeline(const bool enabled, const unsigned bands) {
+    if (pipeline) {
+        pipeline->flush(SCREEN, SCREEN_PALETTE, SCREEN_MASK);
+        pipeline.reset();
+    }
+    if (enabled) pipeline = std::make_unique<RenderPipeline>(bands);
+}
+
+int Console::exec_jit(M6502 *R, const int cycles) {
+#ifdef DENDY_JIT
+    return static_cast<Console *>(R->User)->jit->exec(R, cycles);
+#else
+    return Exec6502(R, cycles);
+#endif
+}
+
+void Console::map_memory() {
+    for (unsigned page = 0; page < 32; ++page) {
+        read_pages[page] = open_bus.data();
+        decoded_pages[page] = nullptr;
+        write_pages[page] = nullptr;
+        io_read[page] = nullptr;
+        io_write[page] = &Console::write_none;
+    }
+
+    // $0000-$1FFF: 2K of RAM mirrored 4 times
+    for (unsigned page = 0; page < 4; ++page) {
+        read_pages[page] = write_pages[page] = RAM;
+    }
+    // $2000-$3FFF: PPU registers mirrored every 8 bytes
+    for (unsigned page = 4; page < 8; ++page) {
+        io_read[page] = &Console::read_ppu;
+        io_write[page] = &Console::write_ppu;
+    }
+    // $4000-$47FF: APU and I/O registers
+    io_read[8] = &Console::read_registers;
+    io_write[8] = &Console::write_registers;
+
+    // $6000-$7FFF: PRG-RAM
+    for (unsigned page = 12; page < 16; ++page) {
+        read_pages[page] = write_pages[page] = &PRGRAM[(page - 12) * 0x800];
+    }
+    // $8000-$FFFF: PRG-ROM, writes go to the mapper
+    for (unsigned page = 16; page < 32; ++page) {
+        io_write[page] = &Console::write_mapper;
+    }
+}
+
+void Console::map_prg(const unsigned slot, const uint8_t *bank) {
+    const Decoded6502 *decoded = &rom->decoded[bank - rom->prg];
+    for (unsigned page = 0; page < 4; ++page) {
+        read_pages[16 + slot * 4 + page] = bank + page * 0x800;
+        decoded_pages[16 + slot * 4 + page] = decoded + page * 0x800;
+    }
+}
+
+void Console::update_banks() {
+    for (unsigned slot = 0; slot < 4; ++slot) {
+        if (read_pages[16 + slot * 4] != mapper.prg[slot]) map_prg(slot, mapper.prg[slot]);
+    }
+    ppu.map(mapper.chr_rom, mapper.chr, mapper.mirroring);
+}
+
+bool Console::load(const char *pathname) {
+    return insert(RomImage::load(pathname));
+}
+
+bool Console::insert(std::shared_ptr<const RomImage> image) {
+    if (!image)
+        return false;
+    if (!Mapper::supported(image->mapper)) {
+        fprintf(stderr, "Mapper %d isn't supported\n", image->mapper);
+        return false;
+    }
+
+    // Frames still being drawn may point into the CHR-ROM of the image going out
+    if (pipeline) pipeline->flush(SCREEN, SCREEN_PALETTE, SCREEN_MASK);
+    rom = std::move(image);
+    mapper.reset(*rom, ppu.CHRRAM);
+    update_banks();
+    if (jit) use_jit(true);
+    return true;
+}
+
+void Console::reset() {
+    memset(RAM, 0, sizeof(RAM));
+    memset(ppu.VRAM, 0, sizeof(ppu.VRAM));
+    memset(SCREEN, 0, NES_WIDTH * NES_HEIGHT);
+
+    // Power-on banks, before the CPU fetches the reset vector
+    if (rom) {
+        mapper.reset(*rom, ppu.CHRRAM);
+        update_banks();
+    }
+    Reset6502(&cpu);
+
+    // M6502::Clock keeps running, the first frame starts now
+    scheduler.cancel_all();
+    frame_start = cpu.Clock * PPU_DOTS_PER_CPU_CYCLE;
+    counter_dot = frame_start;
+    step = 1; // No pre-render line to copy t on
+    if (pipeline) pipeline->restart();
+    scheduler.schedule(vblank_event, scanline_cycle(VBLANK_SCANLINE, 1));
+    watch_sprite0();
+    watch_overflow();
+    apu.reset(cpu.Clock);
+    update_irq();
+}
+
+// Memory read handler for 6502 CPU
+inline uint8_t Console::read(const uint16_t address) {
+    const unsigned page = address >> 11;
+    if (io_read[page]) {
+        return (this->*io_read[page])(address);
+    }
+    return read_pages[page][address & 0x7FF];
+}
+
+// Memory write handler for 6502 CPU
+inline void Console::write(const uint16_t address, const uint8_t value) {
+    const unsigned page = address >> 11;
+    ++cpu.Effects;
+    if (write_pages[page]) {
+        write_pages[page][address & 0x7FF] = value;
+        return;
+    }
+    (this->*io_write[page])(address, value);
+}
+
+uint8_t Console::read_ppu(const uint16_t address) {
+    catch_up(now());
+    if (!ppu.quiet_read(address)) ++cpu.Effects;
+    return ppu.read(address);
+}
+
+void Console::write_ppu(const uint16_t address, const uint8_t value) {
+    const uint8_t nmi_enabled = ppu.nmi_enabled;
+    const bool a12_changes = mapper.counts_scanlines() && (address & 7) <= 1;
+    catch_up(now());
+    if (a12_changes) run_scanline_counter(now());
+    ppu.write(address, value);
+    watch_sprite0();
+    watch_overflow();
+    if (a12_changes) update_irq();
+
+    // Enabling NMI during vblank raises it right after this instruction
+    if (!nmi_enabled && ppu.nmi_enabled && ppu.status & BIT_7) Int6502(&cpu, INT_NMI);
+}
+
+uint8_t Console::read_registers(const uint16_t address) {
+    if (address == 0x4015) {
+        const uint8_t status = apu.read_status(now());
+        // Clears the frame IRQ, and while channels play the bits change with time: polling isn't idle then
+        if (status & ~(BIT_7 | BIT_5)) ++cpu.Effects;
+        update_irq();
+        return status;
+    }
+    if (address == 0x4016) {
+        if (buttons) ++cpu.Effects;
+        const uint8_t bit = buttons & 1;
+        buttons >>= 1;
+        return bit;
+    }
+    return 0xFF;
+}
+
+void Console::write_registers(const uint16_t address, const uint8_t value) {
+    if (address == 0x4014) {
+        catch_up(now());
+        ppu.oam_dma(read_pages[value >> 3] + (value & 7) * 0x100);
+        watch_sprite0();
+        watch_overflow();
+    } else if (address == 0x4016) {
+        if (value) buttons = pad;
+    } else if (address < 0x4018) {
+        apu.write(now(), address, value);
+        update_irq();
+    }
+}
+
+void Console::write_mapper(const uint16_t address, const uint8_t value) {
+    if (!rom) return; // No cartridge, no banks to switch
+
+    if (mapper.counts_scanlines()) run_scanline_counter(now());
+    mapper.write(address, value);
+
+    // Lines due so far are drawn with the patterns and nametables they had
+    if (!ppu.mapped(mapper.chr, mapper.mirroring)) catch_up(now());
+    update_banks();
+    if (mapper.counts_scanlines()) update_irq();
+}
+
+
+void Console::frame() {
+    run_until(scanline_cycle(NTSC_SCANLINES_PER_FRAME));
+    apu.end_frame(cpu.Clock);
+}
+
+void Console::run_until(const uint64_t time) {
+    while (cpu.Clock < time) {
+        // Between instructions, so whatever raised the line has finished. Does nothing while I_FLAG is set,
+        // M_IRQ takes it once CLI, PLP or RTI clears it.
+        if (cpu.IRequest == INT_IRQ) Int6502(&cpu, INT_IRQ);
+
+        const uint64_t deadline = std::min(scheduler.next(), time);
+        run_end = deadline;
+        if (cpu.Clock < deadline) exec(&cpu, static_cast<int>(deadline - cpu.Clock));
+
+        // Events change the machine behind the CPU's back, idle loop detection has to know (IDLE_SKIP).
+        // The ones at time and later belong to the next run, they may depend on frame_start.
+        if (scheduler.run(std::min<uint64_t>(cpu.Clock, time - 1))) ++cpu.Effects;
+    }
+}
+
+void Console::catch_up(const uint64_t time) {
+    if (step > 2 * VISIBLE_SCANLINES || step_cycle(step) > time) return;
+
+    do {
+        if (!step) {
+            if (ppu.rendering()) ppu.copy_xy();
+        } else if (step & 1) {
+            const unsigned scanline = step / 2;
+            render_log[scanline] = ppu.scanline_state();
+            render_scanline(scanline, time);
+        } else if (ppu.rendering()) {
+            ppu.increment_y();
+            ppu.copy_x();
+        }
+    } while (++step <= 2 * VISIBLE_SCANLINES && step_cycle(step) <= time);
+    watch_sprite0();
+    watch_overflow();
+}
+
+void Console::render_scanline(const unsigned scanline, const uint64_t time) {
+    const ScanlineState &state = render_log[scanline];
+    const bool drawing = !render_skip && !pipeline;
+    if (drawing) {
+        renderer.render_background(ppu, state);
+    } else if (!(ppu.status & BIT_6) && scanline - ppu.OAM[0] - 1 < state.sprite_height) {
+        // Sprite 0 only needs the background under it
+        renderer.render_background(ppu, state, (state.fine_x + ppu.OAM[3]) / TILE_WIDTH, 2);
+    }
+
+    // Sprite 0 hit is checked against the background just drawn, and set when the beam gets there: right away
+    // if this line is rendered late, to catch up with a register write or the end of the frame
+    if (!(ppu.status & BIT_6) && !scheduler.pending(sprite0_event)) {
+        const int x = renderer.sprite0_hit(ppu, scanline, state);
+        if (x >= 0) {
+            const uint64_t hit = scanline_cycle(scanline, x + 1);
+            if (hit <= time) {
+                ppu.status |= BIT_6;
+            } else {
+                scheduler.schedule(sprite0_event, hit);
+            }
+        }
+    }
+
+    // Sprites are evaluated while either layer is on, overflowing lines set the flag
+    if ((state.background_enabled || state.sprites_enabled) && ppu.sprite_line(scanline).overflow) {
+        ppu.status |= BIT_5;
+    }
+    if (!drawing) {
+        if (pipeline && !render_skip) pipeline->record(scanline, state, ppu);
+        return;
+    }
+
+    renderer.render_sprites(ppu, scanline, state);
+    renderer.compose(&SCREEN[scanline * NES_WIDTH]);
+}
+
+void Console::watch_sprite0() {
+    const unsigned top = ppu.OAM[0] + 1;
+    const unsigned first = std::max(top, step / 2); // Next line to render
+    if (!(ppu.status & BIT_6) && !scheduler.pending(sprite0_event) && ppu.background_enabled &&
+        ppu.sprites_enabled && first < std::min<unsigned>(top + ppu.sprite_height, VISIBLE_SCANLINES)) {
+        scheduler.schedule(sprite0_line_event, scanline_cycle(first));
+    } else {
+        scheduler.cancel(sprite0_line_event);
+    }
+}
+
+void Console::watch_overflow() {
+    // The sprite lists are only built for it while the flag can still be set
+    if (!(ppu.status & BIT_5) && ppu.rendering() && step <= 2 * VISIBLE_SCANLINES &&
+        ppu.overflow_line(step / 2) < VISIBLE_SCANLINES) {
+        scheduler.schedule(overflow_line_event, scanline_cycle(ppu.overflow_line(step / 2)));
+    } else {
+        scheduler.cancel(overflow_line_event);
+    }
+}
+
+void Console::update_irq() {
+    cpu.IRequest = apu.irq() || mapper.irq() ? INT_IRQ : INT_NONE;
+
+    const uint64_t next = apu.next_irq();
+    if (next == APU::NEVER) {
+        scheduler.cancel(apu_event);
+    } else {
+        scheduler.schedule(apu_event, next);
+    }
+
+    // The rise the counter runs out at, on the cycle its dot is in
+    const uint64_t lines = mapper.scanlines_to_irq();
+    if (lines == Mapper::NEVER || !a12_rise_offset()) {
+        scheduler.cancel(mapper_event);
+    } else {
+        const uint64_t dot = a12_rise_dot(a12_rises(counter_dot) + static_cast<int64_t>(lines));
+        scheduler.schedule(mapper_event, (dot + PPU_DOTS_PER_CPU_CYCLE - 1) / PPU_DOTS_PER_CPU_CYCLE);
+    }
+    stop_for_events();
+}
+
+void Console::stop_for_events() {
+    // An IRQ the CPU can take ends the run with this instruction, run_until() delivers it
+    const bool irq = cpu.IRequest == INT_IRQ && !(cpu.P & I_FLAG);
+    const uint64_t time = irq ? now() : std::max(scheduler.next(), now());
+    if (time >= run_end) return;
+
+    const uint64_t cut = run_end - time;
+    cpu.Clock -= cut;
+    cpu.Left -= static_cast<int>(cut);
+    run_end = time;
+}
+
+void Console::run_scanline_counter(const uint64_t time) {
+    const uint64_t dot = time * PPU_DOTS_PER_CPU_CYCLE;
+    if (dot <= counter_dot) return;
+    mapper.clock_scanlines(a12_rises(dot) - a12_rises(counter_dot));
+    counter_dot = dot;
+}
+
+unsigned Console::a12_rise_offset() const {
+    if (!ppu.rendering() || (ppu.sprite_height == 8 && ppu.sprite_tiles == ppu.background_tiles)) return 0;
+    return ppu.background_tiles ? 324 : 260;
+}
+
+int64_t Console::a12_rises(const uint64_t dot) const {
+    const unsigned offset = a12_rise_offset();
+    if (!offset) return 0;
+
+    // From the first rise of the pre-render line before the current frame, in whole frames and then lines
+    const int64_t since = static_cast<int64_t>(dot - frame_start) + PPU_DOTS_PER_SCANLINE - offset;
+    const int64_t frames = (since >= 0 ? since : since - FRAME_DOTS + 1) / FRAME_DOTS;
+    const int64_t line = (since - frames * FRAME_DOTS) / PPU_DOTS_PER_SCANLINE;
+    return frames * A12_RISES_PER_FRAME + std::min<int64_t>(line + 1, A12_RISES_PER_FRAME);
+}
+
+uint64_t Console::a12_rise_dot(const int64_t rise) const {
+    // rise counts the first one as 1
+    const int64_t frames = (rise > 0 ? rise - 1 : rise - A12_RISES_PER_FRAME) / A12_RISES_PER_FRAME;
+    const int64_t line = rise - 1 - frames * A12_RISES_PER_FRAME;
+    return frame_start - PPU_DOTS_PER_SCANLINE + a12_rise_offset() + frames * FRAME_DOTS
+           + line * PPU_DOTS_PER_SCANLINE;
+}
+
+void Console::start_vblank(const uint64_t time) {
+    catch_up(time);
+    if (pipeline && !render_skip) {
+        pipeline->submit(ppu, SCREEN, SCREEN_PALETTE, SCREEN_MASK);
+    } else if (!render_skip) {
+        memcpy(SCREEN_PALETTE, ppu.PALETTE, sizeof(SCREEN_PALETTE));
+        SCREEN_MASK = ppu.mask;
+    }
+    ppu.status |= BIT_7;
+    if (ppu.nmi_enabled) Int6502(&cpu, INT_NMI);
+    scheduler.schedule(prerender_event, scanline_cycle(PRERENDER_SCANLINE, 1));
+}
+
+void Console::end_vblank(const uint64_t time) {
+    ppu.status &= ~(BIT_7 | BIT_6 | BIT_5);
+
+    // The next frame starts after this line
+    frame_start += NTSC_SCANLINES_PER_FRAME * PPU_DOTS_PER_SCANLINE;
+    step = 0;
+    scheduler.schedule(vblank_event, scanline_cycle(VBLANK_SCANLINE, 1));
+    watch_sprite0();
+    watch_overflow();
+}
+
+}
+
+// M6502 callbacks, R->User is the owning console
+extern "C" {
+
+byte Rd6502(M6502 *R, word Addr) {
+    return static_cast<dendy::Console *>(R->User)->read(Addr);
+}
+
+void Wr6502(M6502 *R, word Addr, byte Value) {
+    static_cast<dendy::Console *>(R->User)->write(Addr, Value);
+}
+
+byte Patch6502(byte Op, M6502 *R) {
+    return 0;
+}
+
+}
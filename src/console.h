@@ -0,0 +1,215 @@
+#pragma once
+#include <memory>
+
+#include "apu.h"
+#include "mapper.h"
+#include "nes.h"
+#include "ppu.h"
+#include "render_pipeline.h"
+#include "renderer.h"
+#include "rom_image.h"
+#include "scheduler.h"
+#include "m6502/M6502.h"
+
+namespace dendy {
+
+class Jit;
+
+// Standard controller buttons in $4016 shift order
+enum {
+    BUTTON_A = BIT_0,
+    BUTTON_B = BIT_1,
+    BUTTON_SELECT = BIT_2,
+    BUTTON_START = BIT_3,
+    BUTTON_UP = BIT_4,
+    BUTTON_DOWN = BIT_5,
+    BUTTON_LEFT = BIT_6,
+    BUTTON_RIGHT = BIT_7,
+};
+
+// One emulated console: owns CPU, PPU, memory and cartridge state, so any number of them can live in a process.
+// The CPU finds its console through M6502::User, so instances must not be copied or moved.
+class Console {
+public:
+    Console();
+    ~Console();
+
+    Console(const Console &) = delete;
+    Console &operator=(const Console &) = delete;
+
+    // Loads an iNES image through the shared RomImage cache, returns false if the file can't be read or isn't iNES
+    bool load(const char *pathname);
+
+    // Plugs in an already loaded image, consoles running the same game share it
+    bool insert(std::shared_ptr<const RomImage> image);
+
+    void reset();
+
+    // Runs one frame: renders SCREEN and executes the CPU for all scanlines
+    void frame();
+
+    // Runs the CPU and whatever events fall due up to (not including) the given cycle of M6502::Clock
+    void run_until(uint64_t time);
+
+    // Render-skip mode, for runs that only need the state or the last frame: lines are no longer drawn into
+    // SCREEN, but everything games can see of the PPU still happens on time (vblank and NMI, v/t, sprite 0 hit
+    // tested on the two background tiles under it, sprite overflow). Takes effect from the next line.
+    void set_render_skip(const bool enabled) { render_skip = enabled; }
+
+    // Pipelined rendering: frames are drawn on a worker thread while the CPU runs the next one (RenderPipeline),
+    // SCREEN, SCREEN_PALETTE and SCREEN_MASK then show the frame before the one frame() just ran. Turning it off
+    // waits for the last frame handed over and copies it out, so SCREEN is up to date again. bands > 1 splits
+    // drawing a frame between that many threads (BandRenderer).
+    void use_pipeline(bool enabled, unsigned bands = 1);
+
+    // Frame handed over to the pipeline last, recorded as drawn, nullptr without the pipeline
+    const RecordedFrame *recorded_frame() const { return pipeline ? &pipeline->submitted() : nullptr; }
+
+    // Pad state latched on the next $4016 strobe, BUTTON_* bits
+    void set_buttons(const uint8_t buttons) { pad = buttons; }
+
+    // CPU bus, see the page tables below. Writes and reads that change state count in cpu.Effects (IDLE_SKIP).
+    uint8_t read(uint16_t address);
+
+    void write(uint16_t address, uint8_t value);
+
+    M6502 cpu = {};
+    PPU ppu;
+    APU apu; // Makes samples each frame(), at the rate set on it
+
+    // Timed events on the CPU clock, components add their own
+    Scheduler scheduler;
+
+    // Switches frame() to the x86-64 block translator (Jit) or back to Exec6502. Returns false, leaving the
+    // interpreter in place, if the build has no translator or no ROM is inserted yet.
+    bool use_jit(bool enabled);
+
+    // CPU dispatcher frame() runs scanlines with, dendy-bench swaps in ExecSwitch6502 to compare
+    int (*exec)(M6502 *R, int cycles) = Exec6502;
+
+    uint8_t RAM[2048] = { 0 };
+    uint8_t PRGRAM[8192] = { 0 };
+    uint8_t SCREEN[NES_WIDTH * NES_HEIGHT] = { 0 }; // Palette indexes, sprites at $10-$1F
+    // PPU::PALETTE and PPU_MASK as of the vblank SCREEN was finished at, ScreenConverter colours it with them
+    uint8_t SCREEN_PALETTE[32] = { 0 };
+    uint8_t SCREEN_MASK = 0;
+
+private:
+    using read_handler = uint8_t (Console::*)(uint16_t address);
+    using write_handler = void (Console::*)(uint16_t address, uint8_t value);
+
+    uint8_t read_ppu(uint16_t address);
+    uint8_t read_registers(uint16_t address);
+
+    void write_ppu(uint16_t address, uint8_t value);
+    void write_registers(uint16_t address, uint8_t value);
+    void write_mapper(uint16_t address, uint8_t value);
+    void write_none(uint16_t address, uint8_t value) {}
+
+    void map_memory();
+
+    // CPU cycle the current instruction ends at, as Rd6502()/Wr6502() calls that reach I/O see it
+    uint64_t now() const { return cpu.Clock - cpu.Left; }
+
+    // Lazy PPU: visible lines are rendered only when something they depend on is about to change (register
+    // writes, OAM DMA, CHR bank switches), when $2002 is read, and at vblank. Catching up takes every step
+    // (see step_cycle()) due by the given time with the state as it is, in one go.
+    void catch_up(uint64_t time);
+
+    // What the PPU does to the visible lines of a frame, in order: step 0 copies t to v on the pre-render line
+    // (dot 257), then each line L starts at step 1 + 2L, snapshotting the registers into render_log and
+    // rendering, and ends at step 2 + 2L (dot 257), moving v down a line and back to the left
+    uint64_t step_cycle(const unsigned step) const {
+        if (!step) {
+            return (frame_start - PPU_DOTS_PER_SCANLINE + 257 + PPU_DOTS_PER_CPU_CYCLE - 1) / PPU_DOTS_PER_CPU_CYCLE;
+        }
+        return scanline_cycle((step - 1) / 2, step & 1 ? 0 : 257);
+    }
+
+    // A line renders its background and sprites from its render_log entry, then composes them into SCREEN. With
+    // render skip or the pipeline on, only what the CPU can see of it is worked out here.
+    void render_scanline(unsigned scanline, uint64_t time);
+
+    // Sprite 0 hit is found by rendering, so a catch-up is scheduled for the first line sprite 0 is on. That
+    // way the hit is set on time, even while nothing else makes the PPU catch up (and IDLE_SKIP can't skip it).
+    void watch_sprite0();
+
+    // Same for sprite overflow: a catch-up at the first overflowing line still to render, or a loop polling
+    // $2002 for the flag would look idle and be skipped up to vblank
+    void watch_overflow();
+
+    // IRQ line for the CPU, the APU's and the mapper's: held in M6502::IRequest while up. It is only taken
+    // between instructions, by run_until(), even when an I/O access in the middle of one raised it. Also moves
+    // the events for the next time either raises it.
+    void update_irq();
+
+    // Events scheduled from I/O during a run that fall before its end: the run stops there instead, so an IRQ
+    // a write sets up for a few lines on isn't taken at the next deadline (see M6502::Left). An IRQ that can
+    // be taken now stops it after the current instruction.
+    void stop_for_events();
+
+    // MMC3 scanline counter: clocked when PPU A12 rises, once a rendering line. Instead of watching for that,
+    // the counter is brought up to date with the lines since the last time, before anything changes what it
+    // counts (PPUCTRL and PPUMASK writes, the mapper's own), and the IRQ is scheduled for the line it runs out.
+    void run_scanline_counter(uint64_t time);
+
+    // A12 rises by a PPU dot as the PPU is set up now, counted from a fixed point in the frame, and the dot of
+    // one of them. While rendering it rises at dot 260 of the pre-render and visible lines when the background
+    // is fetched from $0000 and sprites from $1000, at dot 324 the other way around, and not at all from one
+    // pattern table (0 then). 8x16 sprites count as coming from the table the background isn't.
+    unsigned a12_rise_offset() const;
+    int64_t a12_rises(uint64_t dot) const;
+    uint64_t a12_rise_dot(int64_t rise) const;
+
+    void start_vblank(uint64_t time);
+    void end_vblank(uint64_t time);
+
+    // CPU cycle a dot of a scanline of the current frame starts at, rounding up: 3 dots per cycle don't divide
+    // 341 dots per line, so the fractions carry over from line to line and frame to frame
+    uint64_t scanline_cycle(const unsigned line, const unsigned dot = 0) const {
+        return (frame_start + line * PPU_DOTS_PER_SCANLINE + dot + PPU_DOTS_PER_CPU_CYCLE - 1) / PPU_DOTS_PER_CPU_CYCLE;
+    }
+
+    static int exec_jit(M6502 *R, int cycles);
+
+    // Maps an 8K PRG bank at $8000, $A000, $C000 or $E000 (slot 0-3)
+    void map_prg(unsigned slot, const uint8_t *bank);
+
+    // Points the CPU pages and the PPU at the banks the mapper has now
+    void update_banks();
+
+    // CPU address space in 32 pages of 2 KB. Memory pages (RAM and its mirrors, PRG-RAM, PRG banks) are
+    // plain pointers used by Rd6502 and, through M6502::Page, by the inlined Op6502. I/O pages point at
+    // open bus there and are served by the handler tables instead; writes to unwritable pages always are.
+    // PRG pages also get their pre-decoded code (M6502::Decoded), remapped with the bank, nullptr elsewhere.
+    const uint8_t *read_pages[32] = {};
+    const Decoded6502 *decoded_pages[32] = {};
+    uint8_t *write_pages[32] = {};
+    read_handler io_read[32] = {};
+    write_handler io_write[32] = {};
+
+    std::shared_ptr<const RomImage> rom;
+    Mapper mapper;
+    std::unique_ptr<Jit> jit; // Translated code belongs to the inserted ROM
+
+    Scheduler::event sprite0_line_event;
+    Scheduler::event overflow_line_event;
+    Scheduler::event vblank_event;
+    Scheduler::event prerender_event;
+    Scheduler::event sprite0_event;
+    Scheduler::event apu_event;
+    Scheduler::event mapper_event;
+    uint64_t counter_dot = 0; // PPU dot the scanline counter has run up to
+    uint64_t run_end = 0; // Cycle the current exec() run stops at
+    uint64_t frame_start = 0; // PPU dot the current frame starts at (from the pre-render line on, the next one)
+    unsigned step = 0; // Next step of the frame to take, see step_cycle()
+    ScanlineState render_log[VISIBLE_SCANLINES] = {}; // PPU registers each line of this frame rendered with
+    Renderer renderer;
+    std::unique_ptr<RenderPipeline> pipeline;
+    bool render_skip = false;
+
+    uint8_t pad = 0;
+    uint8_t buttons = 0;
+};
+
+}
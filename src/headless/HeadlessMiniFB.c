@@ -0,0 +1,143 @@
+#include "../MiniFB.h"
+#include "../input_script.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int s_width;
+static int s_height;
+static void *s_buffer;
+static uint32_t s_palette[256] = {0};
+static char key_status[512] = {0};
+
+static unsigned s_frame = 0;
+static unsigned s_max_frames = 0;
+
+static input_script_t s_input_script = {0};
+
+static const char *s_dump_path = NULL;
+static int s_dump_ppm = 0;
+static int s_dump_pattern = 0;
+static FILE *s_dump_stream = NULL;
+
+// Script buttons in $4016 order mapped to the keys the frontend reads
+static const uint8_t button_keys[8] = { 'Z', 'X', VK_SPACE, VK_RETURN, VK_UP, VK_DOWN, VK_LEFT, VK_RIGHT };
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void apply_input_events() {
+    const uint8_t buttons = input_script_buttons(&s_input_script, s_frame);
+    for (int button = 0; button < 8; ++button) {
+        key_status[button_keys[button]] = buttons >> button & 1;
+    }
+}
+
+static void write_frame(FILE *file) {
+    const uint8_t *pixels = s_buffer;
+
+    if (!s_dump_ppm) {
+        fwrite(pixels, 1, s_width * s_height, file);
+        return;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", s_width, s_height);
+    for (int i = 0; i < s_width * s_height; ++i) {
+        const uint32_t color = s_palette[pixels[i]];
+        const uint8_t rgb[3] = { color >> 16 & 0xFF, color >> 8 & 0xFF, color & 0xFF };
+        fwrite(rgb, 1, 3, file);
+    }
+}
+
+static void dump_frame(const int last_frame) {
+    if (!s_dump_path || !s_buffer) return;
+
+    if (s_dump_pattern) {
+        char pathname[1024];
+        snprintf(pathname, sizeof(pathname), s_dump_path, s_frame);
+        FILE *file = fopen(pathname, "wb");
+        if (file) {
+            write_frame(file);
+            fclose(file);
+        }
+    } else if (s_dump_ppm) {
+        if (!last_frame) return;
+        FILE *file = fopen(s_dump_path, "wb");
+        if (file) {
+            write_frame(file);
+            fclose(file);
+        }
+    } else {
+        if (!s_dump_stream) s_dump_stream = fopen(s_dump_path, "wb");
+        if (s_dump_stream) write_frame(s_dump_stream);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int mfb_headless_setup(unsigned max_frames, const char *input_script, const char *dump_path) {
+    s_max_frames = max_frames;
+
+    if (input_script && !input_script_load(&s_input_script, input_script))
+        return 0;
+
+    if (dump_path) {
+        const size_t length = strlen(dump_path);
+        s_dump_path = dump_path;
+        s_dump_ppm = length > 4 && !strcasecmp(dump_path + length - 4, ".ppm");
+        s_dump_pattern = strchr(dump_path, '%') != NULL;
+    }
+
+    apply_input_events();
+    return 1;
+}
+
+int mfb_open(const char *title, int width, int height, int scale) {
+    s_width = width;
+    s_height = height;
+    return 1;
+}
+
+void mfb_set_pallete_array(const uint32_t *new_palette, uint8_t start, uint8_t count) {
+    for (int i = start; i < start + count; i++) {
+        s_palette[i] = new_palette[i - start];
+    }
+}
+
+void mfb_set_pallete(const uint8_t color_index, const uint32_t color) {
+    s_palette[color_index] = color;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// No window and no frame limiter: fps_limit is ignored and frames are produced as fast as the CPU allows
+int mfb_update(void *buffer, int fps_limit) {
+    s_buffer = buffer;
+    ++s_frame;
+
+    const int last_frame = s_max_frames && s_frame >= s_max_frames;
+    dump_frame(last_frame);
+
+    if (last_frame)
+        return -1;
+
+    apply_input_events();
+    return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void mfb_close() {
+    input_script_free(&s_input_script);
+    if (s_dump_stream) {
+        fclose(s_dump_stream);
+        s_dump_stream = NULL;
+    }
+    s_buffer = 0;
+}
+
+char *mfb_keystatus() {
+    return key_status;
+}
@@ -0,0 +1,57 @@
+#include "input_script.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Button order matches the $4016 shift register
+static const char *button_names[8] = { "A", "B", "SELECT", "START", "UP", "DOWN", "LEFT", "RIGHT" };
+
+int input_script_load(input_script_t *script, const char *pathname) {
+    memset(script, 0, sizeof(*script));
+
+    FILE *file = fopen(pathname, "r");
+    if (!file) {
+        fprintf(stderr, "Can't open input script %s\n", pathname);
+        return 0;
+    }
+
+    size_t capacity = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char *token = strtok(line, " \t\r\n");
+        if (!token || *token == '#') continue;
+
+        if (script->count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            script->events = realloc(script->events, capacity * sizeof(input_event_t));
+        }
+
+        input_event_t *event = &script->events[script->count++];
+        event->frame = (unsigned) strtoul(token, NULL, 10);
+        event->buttons = 0;
+
+        while ((token = strtok(NULL, " \t\r\n")) && *token != '#') {
+            for (int button = 0; button < 8; ++button) {
+                if (!strcasecmp(token, button_names[button])) {
+                    event->buttons |= 1 << button;
+                }
+            }
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+uint8_t input_script_buttons(input_script_t *script, const unsigned frame) {
+    while (script->next < script->count && script->events[script->next].frame <= frame) {
+        script->buttons = script->events[script->next++].buttons;
+    }
+    return script->buttons;
+}
+
+void input_script_free(input_script_t *script) {
+    free(script->events);
+    memset(script, 0, sizeof(*script));
+}
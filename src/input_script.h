@@ -0,0 +1,32 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Scripted pad input: text file of "<frame> <buttons...>" lines, '#' starts a comment.
+// Buttons are A B SELECT START UP DOWN LEFT RIGHT (or "-" for none) and hold until the next line.
+typedef struct {
+    unsigned frame;
+    uint8_t buttons; // $4016 shift order, A = bit 0
+} input_event_t;
+
+typedef struct {
+    input_event_t *events;
+    size_t count;
+    size_t next;
+    uint8_t buttons;
+} input_script_t;
+
+// Returns 0 if the file can't be read
+int input_script_load(input_script_t *script, const char *pathname);
+
+// Buttons held during the given frame, frames must be passed in increasing order
+uint8_t input_script_buttons(input_script_t *script, unsigned frame);
+
+void input_script_free(input_script_t *script);
+
+#ifdef __cplusplus
+}
+#endif
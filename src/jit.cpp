@@ -0,0 +1,882 @@
+// 6502 to x86-64 block translator. A block is straight-line PRG-ROM code up to a branch, jump or anything
+// it can't translate; it runs with the 6502 registers in host registers and leaves through exit stubs that
+// store PC, charge the cycles of the instructions completed and count them, exactly as Exec6502 would.
+#include "jit.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "m6502/Tables.h"
+
+namespace dendy {
+
+namespace {
+
+// Longest block, keeps translation cheap and exits frequent enough for the cycle check
+#define MAX_BLOCK_INSTRUCTIONS 64
+#define CODE_CHUNK_SIZE (1 << 20)
+
+enum Reg { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// Block calling convention (System V): CPU and cycles come in as the first two arguments and stay there.
+// The 6502 registers live in callee-saved registers, zero-extended to 32 bits.
+constexpr Reg CPU = RDI, CYCLES = RSI, RAM = R12, ZN = R13;
+constexpr Reg REG_A = RBX, REG_X = RBP, REG_Y = R14, REG_P = R15;
+
+enum Cond { CC_B = 2, CC_AE = 3, CC_E = 4, CC_NE = 5 };
+enum Alu { ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6, ALU_CMP = 7 };
+
+struct Mem {
+    Reg base;
+    int index = -1;
+    int scale = 1;
+    int32_t disp = 0;
+};
+
+Mem at(const Reg base, const int32_t disp = 0) { return { base, -1, 1, disp }; }
+Mem at(const Reg base, const Reg index, const int32_t disp = 0, const int scale = 1) {
+    return { base, index, scale, disp };
+}
+
+struct Label {
+    long target = -1;
+    std::vector<size_t> fixups;
+};
+
+// Just the x86-64 instructions the translator needs, 32-bit operand size unless the name says otherwise
+class Emitter {
+public:
+    std::vector<uint8_t> code;
+
+    void bind(Label &label) {
+        label.target = code.size();
+        for (const size_t fixup : label.fixups) patch32(fixup, label.target - (fixup + 4));
+    }
+
+    void jmp(Label &label) { put(0xE9); rel32(label); }
+    void jcc(const Cond cc, Label &label) { put(0x0F); put(0x80 | cc); rel32(label); }
+    void jmp(const Reg r) { rr({ 0xFF }, 4, r); }
+    void ret() { put(0xC3); }
+    void push(const Reg r) { if (r >= R8) put(0x41); put(0x50 | r & 7); }
+    void pop(const Reg r) { if (r >= R8) put(0x41); put(0x58 | r & 7); }
+
+    void mov(const Reg dst, const Reg src) { rr({ 0x89 }, src, dst); }
+    void mov(const Reg dst, const uint32_t imm) { if (dst >= R8) put(0x41); put(0xB8 | dst & 7); put32(imm); }
+    void mov64(const Reg dst, const uint64_t imm) { put(0x48 | dst >> 3); put(0xB8 | dst & 7); put64(imm); }
+    void load64(const Reg dst, const Mem &m) { rm({ 0x8B }, dst, m, true); }
+    void lea(const Reg dst, const Mem &m) { rm({ 0x8D }, dst, m); }
+    void lea64(const Reg dst, const Mem &m) { rm({ 0x8D }, dst, m, true); }
+
+    void movzx8(const Reg dst, const Mem &m) { rm({ 0x0F, 0xB6 }, dst, m); }
+    void movzx8(const Reg dst, const Reg src) { rr({ 0x0F, 0xB6 }, dst, src, false, src >= RSP && src <= RDI); }
+    void movzx16(const Reg dst, const Reg src) { rr({ 0x0F, 0xB7 }, dst, src); }
+
+    void store8(const Mem &m, const Reg src) { rm({ 0x88 }, src, m, false, src >= RSP && src <= RDI); }
+    void store8(const Mem &m, const uint8_t imm) { rm({ 0xC6 }, 0, m); put(imm); }
+    void store16(const Mem &m, const Reg src) { put(0x66); rm({ 0x89 }, src, m); }
+    void store16(const Mem &m, const uint16_t imm) { put(0x66); rm({ 0xC7 }, 0, m); put(imm & 0xFF); put(imm >> 8); }
+
+    void alu(const Alu op, const Reg dst, const Reg src) { rr({ static_cast<uint8_t>(op << 3 | 1) }, src, dst); }
+    void alu(const Alu op, const Reg dst, const int32_t imm) {
+        if (imm >= -128 && imm <= 127) {
+            rr({ 0x83 }, op, dst);
+            put(imm);
+        } else {
+            rr({ 0x81 }, op, dst);
+            put32(imm);
+        }
+    }
+    void add64(const Mem &m, const int32_t imm) {
+        if (imm >= -128 && imm <= 127) {
+            rm({ 0x83 }, ALU_ADD, m, true);
+            put(imm);
+        } else {
+            rm({ 0x81 }, ALU_ADD, m, true);
+            put32(imm);
+        }
+    }
+
+    void inc(const Reg r) { rr({ 0xFF }, 0, r); }
+    void dec(const Reg r) { rr({ 0xFF }, 1, r); }
+    void inc8(const Mem &m) { rm({ 0xFE }, 0, m); }
+    void dec8(const Mem &m) { rm({ 0xFE }, 1, m); }
+    void inc32(const Mem &m) { rm({ 0xFF }, 0, m); }
+    void dec32(const Mem &m) { rm({ 0xFF }, 1, m); }
+    void shl(const Reg r, const uint8_t n) { rr({ 0xC1 }, 4, r); put(n); }
+    void shr(const Reg r, const uint8_t n) { rr({ 0xC1 }, 5, r); put(n); }
+    void bit_not(const Reg r) { rr({ 0xF7 }, 2, r); }
+    void test(const Reg a, const Reg b) { rr({ 0x85 }, b, a); }
+    void test(const Reg r, const int32_t imm) { rr({ 0xF7 }, 0, r); put32(imm); }
+    void setcc(const Cond cc, const Reg r) { rr({ 0x0F, static_cast<uint8_t>(0x90 | cc) }, 0, r, false, r >= RSP && r <= RDI); }
+
+private:
+    void put(const uint8_t byte) { code.push_back(byte); }
+    void put32(const uint32_t value) { for (int i = 0; i < 32; i += 8) put(value >> i); }
+    void put64(const uint64_t value) { for (int i = 0; i < 64; i += 8) put(value >> i); }
+    void patch32(const size_t offset, const uint32_t value) {
+        for (int i = 0; i < 4; ++i) code[offset + i] = value >> i * 8;
+    }
+
+    void rel32(Label &label) {
+        if (label.target >= 0) {
+            put32(label.target - static_cast<long>(code.size() + 4));
+        } else {
+            label.fixups.push_back(code.size());
+            put32(0);
+        }
+    }
+
+    // force: byte access to SPL/BPL/SIL/DIL, which needs a REX prefix to not mean AH/CH/DH/BH
+    void rex(const bool w, const int reg, const int index, const int base, const bool force) {
+        const uint8_t prefix = 0x40 | w << 3 | (reg >> 3 & 1) << 2 | (index >> 3 & 1) << 1 | (base >> 3 & 1);
+        if (prefix != 0x40 || force) put(prefix);
+    }
+
+    void rr(const std::initializer_list<uint8_t> opcode, const int reg, const int rm, const bool w = false,
+            const bool force = false) {
+        rex(w, reg, 0, rm, force);
+        for (const uint8_t byte : opcode) put(byte);
+        put(0xC0 | (reg & 7) << 3 | rm & 7);
+    }
+
+    void rm(const std::initializer_list<uint8_t> opcode, const int reg, const Mem &m, const bool w = false,
+            const bool force = false) {
+        rex(w, reg, m.index < 0 ? 0 : m.index, m.base, force);
+        for (const uint8_t byte : opcode) put(byte);
+
+        const int mod = m.disp == 0 && (m.base & 7) != RBP ? 0 : m.disp >= -128 && m.disp <= 127 ? 1 : 2;
+        if (m.index >= 0 || (m.base & 7) == RSP) {
+            const int scale = m.scale == 8 ? 3 : m.scale == 4 ? 2 : m.scale == 2 ? 1 : 0;
+            put(mod << 6 | (reg & 7) << 3 | RSP);
+            put(scale << 6 | (m.index < 0 ? RSP : m.index & 7) << 3 | m.base & 7);
+        } else {
+            put(mod << 6 | (reg & 7) << 3 | m.base & 7);
+        }
+        if (mod == 1) put(m.disp);
+        if (mod == 2) put32(m.disp);
+    }
+};
+
+enum Mode : uint8_t { IMP, ACC, IMM, ZP, ZPX, ZPY, ABS, ABX, ABY, IZX, IZY, REL };
+
+enum Kind : uint8_t {
+    NONE,
+    LDA, LDX, LDY, STA, STX, STY,
+    ADC, SBC, AND, ORA, EOR, CMP, CPX, CPY, BIT,
+    ASL, LSR, ROL, ROR, INC, DEC,
+    CLC, SEC, CLV, CLD, SED, SEI,
+    TAX, TXA, TAY, TYA, TSX, TXS, INX, DEX, INY, DEY, NOP,
+    PHA, PHP, PLA,
+    BPL, BMI, BVC, BVS, BCC, BCS, BNE, BEQ,
+    JMP, JSR, RTS,
+};
+
+struct Opcode {
+    Kind kind = NONE;
+    Mode mode = IMP;
+};
+
+// Official opcodes the translator handles. BRK, RTI, JMP (ind), CLI, PLP and the illegal ones stay on Exec6502.
+static const std::array<Opcode, 256> opcodes = [] {
+    std::array<Opcode, 256> table {};
+    const auto group = [&table](const Kind kind, const std::initializer_list<std::pair<int, Mode>> modes) {
+        for (const auto &[code, mode] : modes) table[code] = { kind, mode };
+    };
+    group(ORA, { { 0x09, IMM }, { 0x05, ZP }, { 0x15, ZPX }, { 0x0D, ABS }, { 0x1D, ABX }, { 0x19, ABY }, { 0x01, IZX }, { 0x11, IZY } });
+    group(AND, { { 0x29, IMM }, { 0x25, ZP }, { 0x35, ZPX }, { 0x2D, ABS }, { 0x3D, ABX }, { 0x39, ABY }, { 0x21, IZX }, { 0x31, IZY } });
+    group(EOR, { { 0x49, IMM }, { 0x45, ZP }, { 0x55, ZPX }, { 0x4D, ABS }, { 0x5D, ABX }, { 0x59, ABY }, { 0x41, IZX }, { 0x51, IZY } });
+    group(ADC, { { 0x69, IMM }, { 0x65, ZP }, { 0x75, ZPX }, { 0x6D, ABS }, { 0x7D, ABX }, { 0x79, ABY }, { 0x61, IZX }, { 0x71, IZY } });
+    group(STA, { { 0x85, ZP }, { 0x95, ZPX }, { 0x8D, ABS }, { 0x9D, ABX }, { 0x99, ABY }, { 0x81, IZX }, { 0x91, IZY } });
+    group(LDA, { { 0xA9, IMM }, { 0xA5, ZP }, { 0xB5, ZPX }, { 0xAD, ABS }, { 0xBD, ABX }, { 0xB9, ABY }, { 0xA1, IZX }, { 0xB1, IZY } });
+    group(CMP, { { 0xC9, IMM }, { 0xC5, ZP }, { 0xD5, ZPX }, { 0xCD, ABS }, { 0xDD, ABX }, { 0xD9, ABY }, { 0xC1, IZX }, { 0xD1, IZY } });
+    group(SBC, { { 0xE9, IMM }, { 0xE5, ZP }, { 0xF5, ZPX }, { 0xED, ABS }, { 0xFD, ABX }, { 0xF9, ABY }, { 0xE1, IZX }, { 0xF1, IZY } });
+    group(ASL, { { 0x0A, ACC }, { 0x06, ZP }, { 0x16, ZPX }, { 0x0E, ABS }, { 0x1E, ABX } });
+    group(ROL, { { 0x2A, ACC }, { 0x26, ZP }, { 0x36, ZPX }, { 0x2E, ABS }, { 0x3E, ABX } });
+    group(LSR, { { 0x4A, ACC }, { 0x46, ZP }, { 0x56, ZPX }, { 0x4E, ABS }, { 0x5E, ABX } });
+    group(ROR, { { 0x6A, ACC }, { 0x66, ZP }, { 0x76, ZPX }, { 0x6E, ABS }, { 0x7E, ABX } });
+    group(STX, { { 0x86, ZP }, { 0x96, ZPY }, { 0x8E, ABS } });
+    group(LDX, { { 0xA2, IMM }, { 0xA6, ZP }, { 0xB6, ZPY }, { 0xAE, ABS }, { 0xBE, ABY } });
+    group(DEC, { { 0xC6, ZP }, { 0xD6, ZPX }, { 0xCE, ABS }, { 0xDE, ABX } });
+    group(INC, { { 0xE6, ZP }, { 0xF6, ZPX }, { 0xEE, ABS }, { 0xFE, ABX } });
+    group(BIT, { { 0x24, ZP }, { 0x2C, ABS } });
+    group(STY, { { 0x84, ZP }, { 0x94, ZPX }, { 0x8C, ABS } });
+    group(LDY, { { 0xA0, IMM }, { 0xA4, ZP }, { 0xB4, ZPX }, { 0xAC, ABS }, { 0xBC, ABX } });
+    group(CPY, { { 0xC0, IMM }, { 0xC4, ZP }, { 0xCC, ABS } });
+    group(CPX, { { 0xE0, IMM }, { 0xE4, ZP }, { 0xEC, ABS } });
+
+    const std::pair<int, Kind> implied[] = {
+        { 0x18, CLC }, { 0x38, SEC }, { 0xB8, CLV }, { 0xD8, CLD }, { 0xF8, SED }, { 0x78, SEI },
+        { 0xAA, TAX }, { 0x8A, TXA }, { 0xA8, TAY }, { 0x98, TYA }, { 0xBA, TSX }, { 0x9A, TXS },
+        { 0xE8, INX }, { 0xCA, DEX }, { 0xC8, INY }, { 0x88, DEY }, { 0xEA, NOP },
+        { 0x48, PHA }, { 0x08, PHP }, { 0x68, PLA }, { 0x60, RTS },
+    };
+    for (const auto &[code, kind] : implied) table[code] = { kind, IMP };
+
+    const std::pair<int, Kind> branches[] = {
+        { 0x10, BPL }, { 0x30, BMI }, { 0x50, BVC }, { 0x70, BVS },
+        { 0x90, BCC }, { 0xB0, BCS }, { 0xD0, BNE }, { 0xF0, BEQ },
+    };
+    for (const auto &[code, kind] : branches) table[code] = { kind, REL };
+
+    table[0x4C] = { JMP, ABS };
+    table[0x20] = { JSR, ABS };
+    return table;
+}();
+
+static unsigned instruction_length(const Mode mode) {
+    switch (mode) {
+        case IMP: case ACC: return 1;
+        case ABS: case ABX: case ABY: return 3;
+        default: return 2;
+    }
+}
+
+// Where the instruction's exits go: the next PC and what the instructions completed so far cost
+struct Exit {
+    Label label;
+    word pc = 0;
+    bool dynamic_pc = false; // PC is in ECX
+    int cycles = 0;
+    int count = 0;
+    bool branch_taken = false; // M_JR also takes a cycle from ICount
+    int idle_end = -1; // Address after a branch or JMP that may close a spin loop, for Idle6502()
+};
+
+class Translator {
+public:
+    explicit Translator(const M6502 *R) : R(R) {}
+
+    Emitter emit;
+    int head_cycles = 0;
+    unsigned length = 0;
+
+    // Returns the number of instructions translated, 0 if the first one can't be
+    int translate(const word start) {
+        prologue();
+
+        word pc = start;
+        int last_cycles = 0;
+        for (;;) {
+            const byte code = read_code(pc);
+            const Opcode &op = opcodes[code];
+            const unsigned size = instruction_length(op.mode);
+
+            // A block never leaves its 8K window: that keeps it inside one PRG bank, whatever the mapping
+            if (count == MAX_BLOCK_INSTRUCTIONS || op.kind == NONE || pc + size - 1 > 0xFFFF ||
+                ((pc + size - 1) & 0xE000) != (start & 0xE000)) {
+                emit.jmp(exit_to(pc).label);
+                break;
+            }
+
+            const word operand = size == 1 ? 0 : size == 2 ? read_code(pc + 1) : read_code(pc + 1) | read_code(pc + 2) << 8;
+            if (!direct(op, operand)) {
+                emit.jmp(exit_to(pc).label);
+                break;
+            }
+
+            this->pc = pc;
+            instruction(op, operand, Cycles[code]);
+
+            last_cycles = Cycles[code];
+            cycles += last_cycles;
+            ++count;
+            pc += size;
+            if (op.kind >= BPL) break;
+        }
+
+        head_cycles = cycles - last_cycles;
+        length = pc - start;
+        epilogue();
+        return count;
+    }
+
+private:
+    const M6502 *R;
+    std::deque<Exit> exits;
+    Label done;
+    Label idle;
+
+    word pc = 0; // Instruction being translated
+    int cycles = 0; // Cycles of the instructions before it
+    int count = 0;
+
+    byte read_code(const word address) const { return R->Page[address >> 11][address & 0x7FF]; }
+
+    static Mem reg(const size_t offset) { return at(CPU, static_cast<int32_t>(offset)); }
+
+    Exit &exit_to(const word next, const int extra_cycles = 0, const int extra_count = 0) {
+        Exit &exit = exits.emplace_back();
+        exit.pc = next;
+        exit.cycles = cycles + extra_cycles;
+        exit.count = count + extra_count;
+        return exit;
+    }
+
+    // Leaves before the current instruction, the interpreter then runs it
+    Exit &bail() { return exit_to(pc); }
+
+    // Static addresses outside RAM and PRG space are I/O, those instructions stay on the interpreter
+    static bool direct(const Opcode &op, const word operand) {
+        if (op.mode != ABS || op.kind == JMP || op.kind == JSR) return true;
+        const bool reads = op.kind != STA && op.kind != STX && op.kind != STY && !(op.kind >= ASL && op.kind <= DEC);
+        return operand < 0x2000 || reads && operand >= 0x6000;
+    }
+
+    void prologue() {
+        for (const Reg r : { RBX, RBP, R12, R13, R14, R15 }) emit.push(r);
+        emit.load64(RAM, reg(offsetof(M6502, Page)));
+        emit.load64(RAM, at(RAM));
+        emit.mov64(ZN, reinterpret_cast<uint64_t>(ZNTable));
+        emit.movzx8(REG_A, reg(offsetof(M6502, A)));
+        emit.movzx8(REG_X, reg(offsetof(M6502, X)));
+        emit.movzx8(REG_Y, reg(offsetof(M6502, Y)));
+        emit.movzx8(REG_P, reg(offsetof(M6502, P)));
+    }
+
+    void epilogue() {
+        for (Exit &exit : exits) {
+            emit.bind(exit.label);
+            if (exit.dynamic_pc) {
+                emit.store16(reg(offsetof(M6502, PC)), RCX);
+            } else {
+                emit.store16(reg(offsetof(M6502, PC)), exit.pc);
+            }
+            if (exit.cycles) emit.alu(ALU_SUB, CYCLES, exit.cycles);
+            if (exit.count) emit.add64(reg(offsetof(M6502, Executed)), exit.count);
+            if (exit.branch_taken) emit.dec32(reg(offsetof(M6502, ICount)));
+            if (exit.idle_end >= 0) {
+                emit.mov(RDX, static_cast<uint32_t>(exit.idle_end));
+                emit.jmp(idle);
+            } else {
+                emit.jmp(done);
+            }
+        }
+
+#ifdef IDLE_SKIP
+        // Same as done, then Idle6502(R, cycles, End) returns to the block's caller
+        if (!idle.fixups.empty()) {
+            emit.bind(idle);
+            store_registers();
+            emit.mov64(RAX, reinterpret_cast<uint64_t>(Idle6502));
+            emit.jmp(RAX);
+        }
+#endif
+
+        emit.bind(done);
+        store_registers();
+        emit.mov(RAX, CYCLES);
+        emit.ret();
+    }
+
+    // Writes A, X, Y and P back and restores the host registers
+    void store_registers() {
+        emit.store8(reg(offsetof(M6502, A)), REG_A);
+        emit.store8(reg(offsetof(M6502, X)), REG_X);
+        emit.store8(reg(offsetof(M6502, Y)), REG_Y);
+        emit.store8(reg(offsetof(M6502, P)), REG_P);
+        for (const Reg r : { R15, R14, R13, R12, RBP, RBX }) emit.pop(r);
+    }
+
+    // Taken branches and jumps that Exec6502 hands to Idle6502() (M_IDLE) do the same here
+    void idle_check(Exit &exit, const word end) {
+#ifdef IDLE_SKIP
+        if (static_cast<word>(end - exit.pc - 1) < IDLE_LOOP_BYTES) exit.idle_end = end;
+#endif
+    }
+
+    // Every write the interpreter makes through Wr6502 counts as a side effect, see Console::write()
+    void count_effect() { emit.inc32(reg(offsetof(M6502, Effects))); }
+
+    // M_FL: Z and N from ZNTable
+    void flags_zn(const Reg value) {
+        emit.movzx8(R8, at(ZN, value));
+        emit.alu(ALU_AND, REG_P, ~(Z_FLAG | N_FLAG));
+        emit.alu(ALU_OR, REG_P, R8);
+    }
+
+    static Reg index_of(const Mode mode) { return mode == ZPY || mode == ABY || mode == IZY ? REG_Y : REG_X; }
+
+    // Reads through R->Page, EAX = address, leaves EAX clobbered
+    void read_page(const Reg dst) {
+        emit.mov(RDX, RAX);
+        emit.shr(RDX, 11);
+        emit.load64(R8, reg(offsetof(M6502, Page)));
+        emit.load64(R8, at(R8, RDX, 0, 8));
+        emit.alu(ALU_AND, RAX, 0x7FF);
+        emit.movzx8(dst, at(R8, RAX));
+    }
+
+    // EAX = effective address of the indexed and indirect modes, 16 bits like MC_Ax/MC_Iy
+    void address(const Mode mode, const word operand) {
+        switch (mode) {
+            case ABX: case ABY:
+                emit.lea(RAX, at(index_of(mode), operand));
+                emit.movzx16(RAX, RAX);
+                break;
+            case IZX:
+                emit.lea(RCX, at(REG_X, operand));
+                emit.movzx8(RCX, RCX);
+                emit.movzx8(RAX, at(RAM, RCX));
+                emit.movzx8(RDX, at(RAM, RCX, 1));
+                emit.shl(RDX, 8);
+                emit.alu(ALU_OR, RAX, RDX);
+                break;
+            case IZY:
+                emit.movzx8(RAX, at(RAM, operand));
+                emit.movzx8(RDX, at(RAM, operand + 1));
+                emit.shl(RDX, 8);
+                emit.alu(ALU_OR, RAX, RDX);
+                emit.alu(ALU_ADD, RAX, REG_Y);
+                emit.movzx16(RAX, RAX);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // EAX = zero page address of ZP,X / ZP,Y
+    void zero_page_indexed(const Mode mode, const word operand) {
+        emit.lea(RAX, at(index_of(mode), operand));
+        emit.movzx8(RAX, RAX);
+    }
+
+    // ECX = operand, like MR_* with Rd6502: RAM directly, PRG-RAM and ROM through R->Page, I/O on the interpreter
+    void read(const Mode mode, const word operand) {
+        switch (mode) {
+            case IMM:
+                emit.alu(ALU_XOR, RCX, RCX);
+                emit.alu(ALU_OR, RCX, operand);
+                return;
+            case ZP:
+                emit.movzx8(RCX, at(RAM, operand));
+                return;
+            case ZPX: case ZPY:
+                zero_page_indexed(mode, operand);
+                emit.movzx8(RCX, at(RAM, RAX));
+                return;
+            case ABS:
+                if (operand < 0x2000) {
+                    emit.movzx8(RCX, at(RAM, operand & 0x7FF));
+                } else {
+                    emit.load64(RAX, reg(offsetof(M6502, Page)));
+                    emit.load64(RAX, at(RAX, (operand >> 11) * 8));
+                    emit.movzx8(RCX, at(RAX, operand & 0x7FF));
+                }
+                return;
+            case ABX: case ABY:
+                if (operand + 0xFF < 0x2000) {
+                    emit.lea(RAX, at(index_of(mode), operand));
+                    emit.alu(ALU_AND, RAX, 0x7FF);
+                    emit.movzx8(RCX, at(RAM, RAX));
+                    return;
+                }
+                if (operand >= 0x6000 && operand + 0xFF <= 0xFFFF) {
+                    emit.lea(RAX, at(index_of(mode), operand));
+                    read_page(RCX);
+                    return;
+                }
+                break;
+            default:
+                break;
+        }
+
+        address(mode, operand);
+        Label high, ready;
+        emit.alu(ALU_CMP, RAX, 0x2000);
+        emit.jcc(CC_AE, high);
+        emit.alu(ALU_AND, RAX, 0x7FF);
+        emit.movzx8(RCX, at(RAM, RAX));
+        emit.jmp(ready);
+        emit.bind(high);
+        emit.alu(ALU_CMP, RAX, 0x6000);
+        emit.jcc(CC_B, bail().label);
+        read_page(RCX);
+        emit.bind(ready);
+    }
+
+    // R9 = host address of a RAM operand for stores and read-modify-write, anything else goes to the interpreter
+    void write_address(const Mode mode, const word operand) {
+        ram_address(mode, operand);
+        count_effect();
+    }
+
+    void ram_address(const Mode mode, const word operand) {
+        switch (mode) {
+            case ZP:
+                emit.lea64(R9, at(RAM, operand));
+                return;
+            case ZPX: case ZPY:
+                zero_page_indexed(mode, operand);
+                emit.lea64(R9, at(RAM, RAX));
+                return;
+            case ABS:
+                emit.lea64(R9, at(RAM, operand & 0x7FF));
+                return;
+            case ABX: case ABY:
+                if (operand + 0xFF < 0x2000) {
+                    emit.lea(RAX, at(index_of(mode), operand));
+                    emit.alu(ALU_AND, RAX, 0x7FF);
+                    emit.lea64(R9, at(RAM, RAX));
+                    return;
+                }
+                break;
+            default:
+                break;
+        }
+
+        address(mode, operand);
+        emit.alu(ALU_CMP, RAX, 0x2000);
+        emit.jcc(CC_AE, bail().label);
+        emit.alu(ALU_AND, RAX, 0x7FF);
+        emit.lea64(R9, at(RAM, RAX));
+    }
+
+    void modify(const Kind kind, const Reg value) {
+        switch (kind) {
+            case ASL:
+                emit.alu(ALU_AND, REG_P, ~C_FLAG);
+                emit.mov(RAX, value);
+                emit.shr(RAX, 7);
+                emit.alu(ALU_OR, REG_P, RAX);
+                emit.shl(value, 1);
+                emit.alu(ALU_AND, value, 0xFF);
+                break;
+            case LSR:
+                emit.alu(ALU_AND, REG_P, ~C_FLAG);
+                emit.mov(RAX, value);
+                emit.alu(ALU_AND, RAX, C_FLAG);
+                emit.alu(ALU_OR, REG_P, RAX);
+                emit.shr(value, 1);
+                break;
+            case ROL:
+                emit.mov(RDX, REG_P);
+                emit.alu(ALU_AND, RDX, C_FLAG);
+                emit.alu(ALU_AND, REG_P, ~C_FLAG);
+                emit.mov(RAX, value);
+                emit.shr(RAX, 7);
+                emit.alu(ALU_OR, REG_P, RAX);
+                emit.shl(value, 1);
+                emit.alu(ALU_OR, value, RDX);
+                emit.alu(ALU_AND, value, 0xFF);
+                break;
+            case ROR:
+                emit.mov(RDX, REG_P);
+                emit.alu(ALU_AND, RDX, C_FLAG);
+                emit.shl(RDX, 7);
+                emit.alu(ALU_AND, REG_P, ~C_FLAG);
+                emit.mov(RAX, value);
+                emit.alu(ALU_AND, RAX, C_FLAG);
+                emit.alu(ALU_OR, REG_P, RAX);
+                emit.shr(value, 1);
+                emit.alu(ALU_OR, value, RDX);
+                break;
+            case INC:
+                emit.inc(value);
+                emit.alu(ALU_AND, value, 0xFF);
+                break;
+            case DEC:
+                emit.dec(value);
+                emit.alu(ALU_AND, value, 0xFF);
+                break;
+            default:
+                break;
+        }
+        flags_zn(value);
+    }
+
+    // M_ADC/M_SBC without decimal mode, with D set the interpreter runs it
+    void arithmetic(const Kind kind) {
+        if (kind == ADC) {
+            emit.mov(RAX, REG_P);
+            emit.alu(ALU_AND, RAX, C_FLAG);
+            emit.alu(ALU_ADD, RAX, REG_A);
+            emit.alu(ALU_ADD, RAX, RCX);
+            emit.mov(RDX, REG_A);
+            emit.alu(ALU_XOR, RDX, RCX);
+            emit.bit_not(RDX);
+        } else {
+            emit.mov(RAX, REG_A);
+            emit.alu(ALU_SUB, RAX, RCX);
+            emit.mov(RDX, REG_P);
+            emit.bit_not(RDX);
+            emit.alu(ALU_AND, RDX, C_FLAG);
+            emit.alu(ALU_SUB, RAX, RDX);
+            emit.mov(RDX, REG_A);
+            emit.alu(ALU_XOR, RDX, RCX);
+        }
+        // V from bit 7 of (A^operand) and (A^result)
+        emit.mov(R8, REG_A);
+        emit.alu(ALU_XOR, R8, RAX);
+        emit.alu(ALU_AND, RDX, R8);
+        emit.alu(ALU_AND, RDX, 0x80);
+        emit.shr(RDX, 1);
+        emit.alu(ALU_AND, REG_P, ~(N_FLAG | V_FLAG | Z_FLAG | C_FLAG));
+        emit.alu(ALU_OR, REG_P, RDX);
+
+        // C: ADC carried out of bit 7, SBC didn't borrow
+        emit.mov(RDX, RAX);
+        if (kind == ADC) {
+            emit.shr(RDX, 8);
+        } else {
+            emit.bit_not(RDX);
+            emit.shr(RDX, 31);
+        }
+        emit.alu(ALU_OR, REG_P, RDX);
+
+        emit.movzx8(REG_A, RAX);
+        emit.movzx8(R8, at(ZN, REG_A));
+        emit.alu(ALU_OR, REG_P, R8);
+    }
+
+    void compare(const Reg value) {
+        emit.mov(RAX, value);
+        emit.alu(ALU_SUB, RAX, RCX);
+        emit.movzx8(RAX, RAX);
+        emit.movzx8(R8, at(ZN, RAX));
+        emit.alu(ALU_AND, REG_P, ~(N_FLAG | Z_FLAG | C_FLAG));
+        emit.alu(ALU_OR, REG_P, R8);
+        emit.alu(ALU_CMP, value, RCX);
+        emit.setcc(CC_AE, RAX);
+        emit.movzx8(RAX, RAX);
+        emit.alu(ALU_OR, REG_P, RAX);
+    }
+
+    void push(const Reg value) {
+        count_effect();
+        emit.movzx8(RAX, reg(offsetof(M6502, S)));
+        emit.store8(at(RAM, RAX, 0x100), value);
+        emit.dec8(reg(offsetof(M6502, S)));
+    }
+
+    void push(const uint8_t value) {
+        count_effect();
+        emit.movzx8(RAX, reg(offsetof(M6502, S)));
+        emit.store8(at(RAM, RAX, 0x100), value);
+        emit.dec8(reg(offsetof(M6502, S)));
+    }
+
+    void pop(const Reg value) {
+        emit.inc8(reg(offsetof(M6502, S)));
+        emit.movzx8(RAX, reg(offsetof(M6502, S)));
+        emit.movzx8(value, at(RAM, RAX, 0x100));
+    }
+
+    void branch(const uint8_t flag, const bool set, const word operand, const int cost) {
+        Exit &taken = exit_to(pc + 2 + static_cast<offset>(operand), cost, 1);
+        taken.branch_taken = true;
+        idle_check(taken, pc + 2);
+        emit.test(REG_P, flag);
+        emit.jcc(set ? CC_NE : CC_E, taken.label);
+        emit.jmp(exit_to(pc + 2, cost, 1).label);
+    }
+
+    void instruction(const Opcode &op, const word operand, const int cost) {
+        switch (op.kind) {
+            case LDA: read(op.mode, operand); emit.mov(REG_A, RCX); flags_zn(REG_A); break;
+            case LDX: read(op.mode, operand); emit.mov(REG_X, RCX); flags_zn(REG_X); break;
+            case LDY: read(op.mode, operand); emit.mov(REG_Y, RCX); flags_zn(REG_Y); break;
+            case AND: read(op.mode, operand); emit.alu(ALU_AND, REG_A, RCX); flags_zn(REG_A); break;
+            case ORA: read(op.mode, operand); emit.alu(ALU_OR, REG_A, RCX); flags_zn(REG_A); break;
+            case EOR: read(op.mode, operand); emit.alu(ALU_XOR, REG_A, RCX); flags_zn(REG_A); break;
+            case CMP: read(op.mode, operand); compare(REG_A); break;
+            case CPX: read(op.mode, operand); compare(REG_X); break;
+            case CPY: read(op.mode, operand); compare(REG_Y); break;
+            case ADC: case SBC:
+                emit.test(REG_P, D_FLAG);
+                emit.jcc(CC_NE, bail().label);
+                read(op.mode, operand);
+                arithmetic(op.kind);
+                break;
+            case BIT:
+                read(op.mode, operand);
+                emit.alu(ALU_AND, REG_P, ~(N_FLAG | V_FLAG | Z_FLAG));
+                emit.mov(RAX, RCX);
+                emit.alu(ALU_AND, RAX, N_FLAG | V_FLAG);
+                emit.alu(ALU_OR, REG_P, RAX);
+                emit.test(RCX, REG_A);
+                emit.setcc(CC_E, RAX);
+                emit.movzx8(RAX, RAX);
+                emit.shl(RAX, 1);
+                emit.alu(ALU_OR, REG_P, RAX);
+                break;
+
+            case STA: write_address(op.mode, operand); emit.store8(at(R9), REG_A); break;
+            case STX: write_address(op.mode, operand); emit.store8(at(R9), REG_X); break;
+            case STY: write_address(op.mode, operand); emit.store8(at(R9), REG_Y); break;
+
+            case ASL: case LSR: case ROL: case ROR: case INC: case DEC:
+                if (op.mode == ACC) {
+                    modify(op.kind, REG_A);
+                } else {
+                    write_address(op.mode, operand);
+                    emit.movzx8(RCX, at(R9));
+                    modify(op.kind, RCX);
+                    emit.store8(at(R9), RCX);
+                }
+                break;
+
+            case CLC: emit.alu(ALU_AND, REG_P, ~C_FLAG); break;
+            case SEC: emit.alu(ALU_OR, REG_P, C_FLAG); break;
+            case CLV: emit.alu(ALU_AND, REG_P, ~V_FLAG); break;
+            case CLD: emit.alu(ALU_AND, REG_P, ~D_FLAG); break;
+            case SED: emit.alu(ALU_OR, REG_P, D_FLAG); break;
+            case SEI: emit.alu(ALU_OR, REG_P, I_FLAG); break;
+
+            case TAX: emit.mov(REG_X, REG_A); flags_zn(REG_X); break;
+            case TXA: emit.mov(REG_A, REG_X); flags_zn(REG_A); break;
+            case TAY: emit.mov(REG_Y, REG_A); flags_zn(REG_Y); break;
+            case TYA: emit.mov(REG_A, REG_Y); flags_zn(REG_A); break;
+            case TSX: emit.movzx8(REG_X, reg(offsetof(M6502, S))); flags_zn(REG_X); break;
+            case TXS: emit.store8(reg(offsetof(M6502, S)), REG_X); break;
+            case INX: modify(INC, REG_X); break;
+            case DEX: modify(DEC, REG_X); break;
+            case INY: modify(INC, REG_Y); break;
+            case DEY: modify(DEC, REG_Y); break;
+            case NOP: break;
+
+            case PHA: push(REG_A); break;
+            case PHP: push(REG_P); break;
+            case PLA: pop(REG_A); flags_zn(REG_A); break;
+
+            case BPL: branch(N_FLAG, false, operand, cost); break;
+            case BMI: branch(N_FLAG, true, operand, cost); break;
+            case BVC: branch(V_FLAG, false, operand, cost); break;
+            case BVS: branch(V_FLAG, true, operand, cost); break;
+            case BCC: branch(C_FLAG, false, operand, cost); break;
+            case BCS: branch(C_FLAG, true, operand, cost); break;
+            case BNE: branch(Z_FLAG, false, operand, cost); break;
+            case BEQ: branch(Z_FLAG, true, operand, cost); break;
+
+            case JMP: {
+                Exit &exit = exit_to(operand, cost, 1);
+                idle_check(exit, pc + 3);
+                emit.jmp(exit.label);
+                break;
+            }
+            case JSR:
+                // Pushes the address of its last byte, like the interpreter
+                push(static_cast<uint8_t>(pc + 2 >> 8));
+                push(static_cast<uint8_t>(pc + 2 & 0xFF));
+                emit.jmp(exit_to(operand, cost, 1).label);
+                break;
+            case RTS: {
+                pop(RCX);
+                pop(RDX);
+                emit.shl(RDX, 8);
+                emit.alu(ALU_OR, RCX, RDX);
+                emit.inc(RCX);
+                emit.movzx16(RCX, RCX);
+                Exit &exit = exit_to(0, cost, 1);
+                exit.dynamic_pc = true;
+                emit.jmp(exit.label);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+};
+
+}
+
+Jit::Jit(std::shared_ptr<const RomImage> image) : rom(std::move(image)) {
+    banks.resize((rom->prg_size >> 13) * 4);
+}
+
+Jit::~Jit() {
+    for (const auto &[memory, size] : chunks) munmap(memory, size);
+}
+
+Jit::Block *Jit::find(const M6502 *R) {
+    const Decoded6502 *page = R->Decoded[R->PC.W >> 11];
+    if (!page) return nullptr;
+
+    const size_t offset = page - rom->decoded.get() + (R->PC.W & 0x7FF);
+    // The same bank can be mapped at several CPU slots (NROM-128, MMC3 PRG mode, UxROM/MMC1 fixed banks) and the
+    // translated code hard-codes the PC it was translated at, so each slot gets its own table
+    std::unique_ptr<Block[]> &bank = banks[(offset >> 13) * 4 + (R->PC.W >> 13 & 3)];
+    if (!bank) bank = std::make_unique<Block[]>(0x2000);
+    return &bank[offset & 0x1FFF];
+}
+
+void Jit::translate(const M6502 *R, Block &block) {
+    block.translated = true;
+
+    Translator translator(R);
+    if (!translator.translate(R->PC.W)) return;
+
+    block.code = install(translator.emit.code);
+    block.head_cycles = translator.head_cycles;
+    block.length = translator.length;
+}
+
+// W^X: chunks are mapped writable, and the pages new code goes to are writable only while it is copied in. If
+// they can't be made executable again the blocks already on them can't run either, the interpreter takes over.
+Jit::block_code Jit::install(const std::vector<uint8_t> &code) {
+    if (chunks.empty() || chunk_used + code.size() > chunks.back().second) {
+        const size_t size = std::max<size_t>(CODE_CHUNK_SIZE, code.size());
+        void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) return nullptr;
+        chunks.emplace_back(static_cast<uint8_t *>(memory), size);
+        chunk_used = 0;
+    }
+
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    uint8_t *const chunk = chunks.back().first;
+    uint8_t *const address = chunk + chunk_used;
+    uint8_t *const pages = chunk + chunk_used / page_size * page_size;
+    const size_t length = address + code.size() - pages;
+
+    if (chunk_used && mprotect(pages, length, PROT_READ | PROT_WRITE) != 0) {
+        executable = false;
+        return nullptr;
+    }
+    memcpy(address, code.data(), code.size());
+    if (mprotect(pages, length, PROT_READ | PROT_EXEC) != 0) {
+        executable = false;
+        return nullptr;
+    }
+    chunk_used += code.size() + 15 & ~size_t(15);
+    return reinterpret_cast<block_code>(address);
+}
+
+int Jit::exec(M6502 *R, int cycles) {
+    // Same R->Clock convention as Exec6502: ahead by the cycles left until returning
+    R->Clock += cycles;
+    while (cycles > 0) {
+        // The debugger steps through the interpreter, as does everything once code can't be made executable
+        if (R->Trace || !executable) {
+            R->Clock -= cycles;
+            return Exec6502(R, cycles);
+        }
+
+        Block *block = find(R);
+        if (block && !block->translated) translate(R, *block);
+
+        // A block runs whole only if the interpreter wouldn't stop inside it, and not over a trap
+        if (block && block->code && cycles > block->head_cycles &&
+            static_cast<word>(R->Trap - R->PC.W) >= block->length) {
+            const int left = block->code(R, cycles);
+            // Left before its first instruction (I/O address, decimal mode): that one goes to the interpreter
+            if (left != cycles) {
+                cycles = left;
+                continue;
+            }
+        }
+        // Exec6502 runs one instruction when given a single cycle. R->Clock goes back to the current cycle for
+        // it, I/O it reaches reads the time there (R->Left).
+        R->Clock -= cycles;
+        const int left = Exec6502(R, 1);
+        cycles += left - 1;
+        R->Clock += cycles;
+    }
+    R->Clock -= cycles;
+    return cycles;
+}
+
+}
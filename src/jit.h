@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "rom_image.h"
+#include "m6502/M6502.h"
+
+namespace dendy {
+
+// x86-64 translator for PRG-ROM basic blocks, an alternative to Exec6502 with the same results.
+// Blocks are keyed by PRG offset and CPU slot and found through M6502::Decoded, so a mapper bank switch retargets
+// the CPU pages to the new bank's blocks just like it does for the decode cache, a bank mapped at two addresses
+// gets code translated for each, and no block spans two 8K banks.
+// Code outside PRG-ROM (RAM, PRG-RAM: possibly self-modifying), I/O accesses, decimal mode and the
+// instructions that touch interrupt state are left to Exec6502, one instruction at a time.
+class Jit {
+public:
+    explicit Jit(std::shared_ptr<const RomImage> image);
+    ~Jit();
+
+    Jit(const Jit &) = delete;
+    Jit &operator=(const Jit &) = delete;
+
+    // Same contract as Exec6502: runs until the cycles are used up, returns what is left (<= 0)
+    int exec(M6502 *R, int cycles);
+
+private:
+    using block_code = int (*)(M6502 *R, int cycles);
+
+    struct Block {
+        block_code code = nullptr; // nullptr when the first instruction can't be translated
+        int head_cycles = 0; // Cycles of all instructions but the last, a block only runs with more than that left
+        uint16_t length = 0; // Bytes of code covered, to honour M6502::Trap
+        bool translated = false;
+    };
+
+    Block *find(const M6502 *R);
+
+    void translate(const M6502 *R, Block &block);
+
+    // Copies translated code to executable memory, nullptr if it can't
+    block_code install(const std::vector<uint8_t> &code);
+
+    std::shared_ptr<const RomImage> rom;
+    std::vector<std::unique_ptr<Block[]>> banks; // One table per 8K PRG bank and CPU slot, allocated on first use
+
+    std::vector<std::pair<uint8_t *, size_t>> chunks;
+    size_t chunk_used = 0;
+    bool executable = true; // False once mprotect() fails
+};
+
+}
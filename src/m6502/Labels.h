@@ -0,0 +1,45 @@
+/** M6502: portable 6502 emulator ****************************/
+/**                                                         **/
+/**                         Labels.h                        **/
+/**                                                         **/
+/** This file contains the dispatch table for the threaded  **/
+/** code version of Exec6502(). It is included from inside  **/
+/** Exec6502() in M6502.c, as label addresses (&&label, a   **/
+/** GCC/Clang extension) only exist within their function.  **/
+/** LABEL(code) names the Codes.h command for each opcode,  **/
+/** the ones missing from Codes.h go to OP_DEFAULT.         **/
+/**                                                         **/
+/*************************************************************/
+
+  LABEL(0x00),LABEL(0x01),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0x05),LABEL(0x06),LABEL(Default),
+  LABEL(0x08),LABEL(0x09),LABEL(0x0A),LABEL(Default),LABEL(Default),LABEL(0x0D),LABEL(0x0E),LABEL(Default),
+  LABEL(0x10),LABEL(0x11),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0x15),LABEL(0x16),LABEL(Default),
+  LABEL(0x18),LABEL(0x19),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0x1D),LABEL(0x1E),LABEL(Default),
+  LABEL(0x20),LABEL(0x21),LABEL(Default),LABEL(Default),LABEL(0x24),LABEL(0x25),LABEL(0x26),LABEL(Default),
+  LABEL(0x28),LABEL(0x29),LABEL(0x2A),LABEL(Default),LABEL(0x2C),LABEL(0x2D),LABEL(0x2E),LABEL(Default),
+  LABEL(0x30),LABEL(0x31),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0x35),LABEL(0x36),LABEL(Default),
+  LABEL(0x38),LABEL(0x39),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0x3D),LABEL(0x3E),LABEL(Default),
+  LABEL(0x40),LABEL(0x41),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0x45),LABEL(0x46),LABEL(Default),
+  LABEL(0x48),LABEL(0x49),LABEL(0x4A),LABEL(Default),LABEL(0x4C),LABEL(0x4D),LABEL(0x4E),LABEL(Default),
+  LABEL(0x50),LABEL(0x51),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0x55),LABEL(0x56),LABEL(Default),
+  LABEL(0x58),LABEL(0x59),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0x5D),LABEL(0x5E),LABEL(Default),
+  LABEL(0x60),LABEL(0x61),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0x65),LABEL(0x66),LABEL(Default),
+  LABEL(0x68),LABEL(0x69),LABEL(0x6A),LABEL(Default),LABEL(0x6C),LABEL(0x6D),LABEL(0x6E),LABEL(Default),
+  LABEL(0x70),LABEL(0x71),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0x75),LABEL(0x76),LABEL(Default),
+  LABEL(0x78),LABEL(0x79),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0x7D),LABEL(0x7E),LABEL(Default),
+  LABEL(Default),LABEL(0x81),LABEL(Default),LABEL(Default),LABEL(0x84),LABEL(0x85),LABEL(0x86),LABEL(Default),
+  LABEL(0x88),LABEL(Default),LABEL(0x8A),LABEL(Default),LABEL(0x8C),LABEL(0x8D),LABEL(0x8E),LABEL(Default),
+  LABEL(0x90),LABEL(0x91),LABEL(Default),LABEL(Default),LABEL(0x94),LABEL(0x95),LABEL(0x96),LABEL(Default),
+  LABEL(0x98),LABEL(0x99),LABEL(0x9A),LABEL(Default),LABEL(Default),LABEL(0x9D),LABEL(Default),LABEL(Default),
+  LABEL(0xA0),LABEL(0xA1),LABEL(0xA2),LABEL(Default),LABEL(0xA4),LABEL(0xA5),LABEL(0xA6),LABEL(Default),
+  LABEL(0xA8),LABEL(0xA9),LABEL(0xAA),LABEL(Default),LABEL(0xAC),LABEL(0xAD),LABEL(0xAE),LABEL(Default),
+  LABEL(0xB0),LABEL(0xB1),LABEL(Default),LABEL(Default),LABEL(0xB4),LABEL(0xB5),LABEL(0xB6),LABEL(Default),
+  LABEL(0xB8),LABEL(0xB9),LABEL(0xBA),LABEL(Default),LABEL(0xBC),LABEL(0xBD),LABEL(0xBE),LABEL(Default),
+  LABEL(0xC0),LABEL(0xC1),LABEL(Default),LABEL(Default),LABEL(0xC4),LABEL(0xC5),LABEL(0xC6),LABEL(Default),
+  LABEL(0xC8),LABEL(0xC9),LABEL(0xCA),LABEL(Default),LABEL(0xCC),LABEL(0xCD),LABEL(0xCE),LABEL(Default),
+  LABEL(0xD0),LABEL(0xD1),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0xD5),LABEL(0xD6),LABEL(Default),
+  LABEL(0xD8),LABEL(0xD9),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0xDD),LABEL(0xDE),LABEL(Default),
+  LABEL(0xE0),LABEL(0xE1),LABEL(Default),LABEL(Default),LABEL(0xE4),LABEL(0xE5),LABEL(0xE6),LABEL(Default),
+  LABEL(0xE8),LABEL(0xE9),LABEL(0xEA),LABEL(Default),LABEL(0xEC),LABEL(0xED),LABEL(0xEE),LABEL(Default),
+  LABEL(0xF0),LABEL(0xF1),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0xF5),LABEL(0xF6),LABEL(Default),
+  LABEL(0xF8),LABEL(0xF9),LABEL(Default),LABEL(Default),LABEL(Default),LABEL(0xFD),LABEL(0xFE),LABEL(Default)
@@ -32,84 +32,122 @@
 /** This is system-dependent code put here to speed things  **/
 /** up. It has to stay inlined to be fast.                  **/
 /*************************************************************/
-#ifdef INES
-#define FAST_RDOP
-extern byte *Page[];
-INLINE byte Op6502(register word A)
-{
-  return(Page[A>>13][A&0x1FFF]);
-}
-#endif /* INES */
-
 #ifdef S60
 extern int Opt6502(M6502 *R);
 #endif
 
 /** FAST_RDOP ************************************************/
-/** With this #define not present, Rd6502() should perform  **/
-/** the functions of Op6502().                              **/
+/** With this #define present, opcodes and operands are     **/
+/** read straight from the 2kB page table in R->Page.       **/
+/** Otherwise Rd6502() performs the functions of Op6502().  **/
 /*************************************************************/
-#ifndef FAST_RDOP
-#define Op6502(A) Rd6502(A)
+#ifdef FAST_RDOP
+INLINE byte OpPage6502(register M6502 *R,register word A)
+{
+  return(R->Page[A>>11][A&0x07FF]);
+}
+#define Op6502(R,A) OpPage6502(R,A)
+#else
+#define Op6502(R,A) Rd6502(R,A)
 #endif
 
+/** Operands *************************************************/
+/** All operand fetches go through these three macros. The  **/
+/** DECODE_CACHE copies of Codes.h in Exec6502() redefine   **/
+/** them to take the operand from a Decoded6502 entry.      **/
+/*************************************************************/
+#include "UseFetched.h"
+
 /** Addressing Methods ***************************************/
 /** These macros calculate and return effective addresses.  **/
 /*************************************************************/
 #define MC_Ab(Rg)	M_LDWORD(Rg)
-#define MC_Zp(Rg)       Rg.W=Op6502(R->PC.W++)
-#define MC_Zx(Rg)       Rg.W=(byte)(Op6502(R->PC.W++)+R->X)
-#define MC_Zy(Rg)       Rg.W=(byte)(Op6502(R->PC.W++)+R->Y)
+#define MC_Zp(Rg)       Rg.W=M_RDOP
+#define MC_Zx(Rg)       Rg.W=(byte)(M_RDOP+R->X)
+#define MC_Zy(Rg)       Rg.W=(byte)(M_RDOP+R->Y)
 #define MC_Ax(Rg)	M_LDWORD(Rg);Rg.W+=R->X
 #define MC_Ay(Rg)	M_LDWORD(Rg);Rg.W+=R->Y
-#define MC_Ix(Rg)       K.W=(byte)(Op6502(R->PC.W++)+R->X); \
-			Rg.B.l=Op6502(K.W++);Rg.B.h=Op6502(K.W)
-#define MC_Iy(Rg)       K.W=Op6502(R->PC.W++); \
-			Rg.B.l=Op6502(K.W++);Rg.B.h=Op6502(K.W); \
+#define MC_Ix(Rg)       K.W=(byte)(M_RDOP+R->X); \
+			Rg.B.l=Op6502(R,K.W++);Rg.B.h=Op6502(R,K.W)
+#define MC_Iy(Rg)       K.W=M_RDOP; \
+			Rg.B.l=Op6502(R,K.W++);Rg.B.h=Op6502(R,K.W); \
 			Rg.W+=R->Y
 
+/** Cycle Sync ***********************************************/
+/** Zero page and stack accesses only reach RAM, the others **/
+/** may hit I/O that wants to know the cycle, see R->Left.  **/
+/** I/O may also end the run sooner by taking as much off   **/
+/** R->Left as off R->Clock, M_RESYNC picks that up.        **/
+/*************************************************************/
+#define M_SYNC		R->Left=RunCycles
+#define M_RESYNC	RunCycles=R->Left
+
 /** Reading From Memory **************************************/
 /** These macros calculate address and read from it.        **/
 /*************************************************************/
-#define MR_Ab(Rg)	MC_Ab(J);Rg=Rd6502(J.W)
-#define MR_Im(Rg)	Rg=Op6502(R->PC.W++)
-#define	MR_Zp(Rg)	MC_Zp(J);Rg=Rd6502(J.W)
-#define MR_Zx(Rg)	MC_Zx(J);Rg=Rd6502(J.W)
-#define MR_Zy(Rg)	MC_Zy(J);Rg=Rd6502(J.W)
-#define	MR_Ax(Rg)	MC_Ax(J);Rg=Rd6502(J.W)
-#define MR_Ay(Rg)	MC_Ay(J);Rg=Rd6502(J.W)
-#define MR_Ix(Rg)	MC_Ix(J);Rg=Rd6502(J.W)
-#define MR_Iy(Rg)	MC_Iy(J);Rg=Rd6502(J.W)
+#define MR_Ab(Rg)	MC_Ab(J);M_SYNC;Rg=Rd6502(R,J.W);M_RESYNC
+#define MR_Im(Rg)	Rg=M_RDOP
+#define	MR_Zp(Rg)	MC_Zp(J);Rg=Rd6502(R,J.W)
+#define MR_Zx(Rg)	MC_Zx(J);Rg=Rd6502(R,J.W)
+#define MR_Zy(Rg)	MC_Zy(J);Rg=Rd6502(R,J.W)
+#define	MR_Ax(Rg)	MC_Ax(J);M_SYNC;Rg=Rd6502(R,J.W);M_RESYNC
+#define MR_Ay(Rg)	MC_Ay(J);M_SYNC;Rg=Rd6502(R,J.W);M_RESYNC
+#define MR_Ix(Rg)	MC_Ix(J);M_SYNC;Rg=Rd6502(R,J.W);M_RESYNC
+#define MR_Iy(Rg)	MC_Iy(J);M_SYNC;Rg=Rd6502(R,J.W);M_RESYNC
 
 /** Writing To Memory ****************************************/
 /** These macros calculate address and write to it.         **/
 /*************************************************************/
-#define MW_Ab(Rg)	MC_Ab(J);Wr6502(J.W,Rg)
-#define MW_Zp(Rg)	MC_Zp(J);Wr6502(J.W,Rg)
-#define MW_Zx(Rg)	MC_Zx(J);Wr6502(J.W,Rg)
-#define MW_Zy(Rg)	MC_Zy(J);Wr6502(J.W,Rg)
-#define MW_Ax(Rg)	MC_Ax(J);Wr6502(J.W,Rg)
-#define MW_Ay(Rg)	MC_Ay(J);Wr6502(J.W,Rg)
-#define MW_Ix(Rg)	MC_Ix(J);Wr6502(J.W,Rg)
-#define MW_Iy(Rg)	MC_Iy(J);Wr6502(J.W,Rg)
+#define MW_Ab(Rg)	MC_Ab(J);M_SYNC;Wr6502(R,J.W,Rg);M_RESYNC
+#define MW_Zp(Rg)	MC_Zp(J);Wr6502(R,J.W,Rg)
+#define MW_Zx(Rg)	MC_Zx(J);Wr6502(R,J.W,Rg)
+#define MW_Zy(Rg)	MC_Zy(J);Wr6502(R,J.W,Rg)
+#define MW_Ax(Rg)	MC_Ax(J);M_SYNC;Wr6502(R,J.W,Rg);M_RESYNC
+#define MW_Ay(Rg)	MC_Ay(J);M_SYNC;Wr6502(R,J.W,Rg);M_RESYNC
+#define MW_Ix(Rg)	MC_Ix(J);M_SYNC;Wr6502(R,J.W,Rg);M_RESYNC
+#define MW_Iy(Rg)	MC_Iy(J);M_SYNC;Wr6502(R,J.W,Rg);M_RESYNC
 
 /** Modifying Memory *****************************************/
 /** These macros calculate address and modify it.           **/
 /*************************************************************/
-#define MM_Ab(Cmd)	MC_Ab(J);I=Rd6502(J.W);Cmd(I);Wr6502(J.W,I)
-#define MM_Zp(Cmd)	MC_Zp(J);I=Rd6502(J.W);Cmd(I);Wr6502(J.W,I)
-#define MM_Zx(Cmd)	MC_Zx(J);I=Rd6502(J.W);Cmd(I);Wr6502(J.W,I)
-#define MM_Ax(Cmd)	MC_Ax(J);I=Rd6502(J.W);Cmd(I);Wr6502(J.W,I)
+#define MM_Ab(Cmd)	MC_Ab(J);M_SYNC;I=Rd6502(R,J.W);Cmd(I);Wr6502(R,J.W,I);M_RESYNC
+#define MM_Zp(Cmd)	MC_Zp(J);I=Rd6502(R,J.W);Cmd(I);Wr6502(R,J.W,I)
+#define MM_Zx(Cmd)	MC_Zx(J);I=Rd6502(R,J.W);Cmd(I);Wr6502(R,J.W,I)
+#define MM_Ax(Cmd)	MC_Ax(J);M_SYNC;I=Rd6502(R,J.W);Cmd(I);Wr6502(R,J.W,I);M_RESYNC
 
 /** Other Macros *********************************************/
 /** Calculating flags, stack, jumps, arithmetics, etc.      **/
 /*************************************************************/
 #define M_FL(Rg)	R->P=(R->P&~(Z_FLAG|N_FLAG))|ZNTable[Rg]
-#define M_LDWORD(Rg)	Rg.B.l=Op6502(R->PC.W++);Rg.B.h=Op6502(R->PC.W++)
 
-#define M_PUSH(Rg)	Wr6502(0x0100|R->S,Rg);R->S--
-#define M_POP(Rg)	R->S++;Rg=Op6502(0x0100|R->S)
-#define M_JR		R->PC.W+=(offset)Op6502(R->PC.W)+1;R->ICount--
+#define M_PUSH(Rg)	Wr6502(R,0x0100|R->S,Rg);R->S--
+#define M_POP(Rg)	R->S++;Rg=Op6502(R,0x0100|R->S)
+#define M_JR		K.W=R->PC.W+1;R->PC.W=K.W+M_RDREL; \
+			R->ICount--;M_IDLE(K.W)
+
+/** IDLE_SKIP ************************************************/
+/** Backward branches and jumps landing at most             **/
+/** IDLE_LOOP_BYTES before End, the address following them, **/
+/** may close a spin loop, Idle6502() checks for that.      **/
+/*************************************************************/
+#if defined(EXEC6502) && defined(IDLE_SKIP)
+#define M_IDLE(End) \
+  if((word)((End)-R->PC.W-1)<IDLE_LOOP_BYTES) \
+    RunCycles=Idle6502(R,RunCycles,End)
+#else
+#define M_IDLE(End)
+#endif
+
+/** IRQ line *************************************************/
+/** Exec6502() has no Loop6502() to realize R->IRequest, so **/
+/** an IRQ held pending while I_FLAG was set is taken as    **/
+/** soon as CLI, PLP or RTI clear it, after that command.   **/
+/*************************************************************/
+#ifdef EXEC6502
+#define M_IRQ if(R->IRequest==INT_IRQ) Int6502(R,INT_IRQ)
+#else
+#define M_IRQ
+#endif
 
 #ifdef NO_DECIMAL
 
@@ -201,25 +239,122 @@ extern int Opt6502(M6502 *R);
 void Reset6502(M6502 *R)
 {
   R->A=R->X=R->Y=0x00;
-  R->P=Z_FLAG|R_FLAG;
+  R->P=Z_FLAG|R_FLAG|I_FLAG;
   R->S=0xFF;
-  R->PC.B.l=Rd6502(0xFFFC);
-  R->PC.B.h=Rd6502(0xFFFD);   
+  R->PC.B.l=Rd6502(R,0xFFFC);
+  R->PC.B.h=Rd6502(R,0xFFFD);   
   R->ICount=R->IPeriod;
   R->IRequest=INT_NONE;
   R->AfterCLI=0;
 }
 
+/** Decode6502() *********************************************/
+/** This function pre-decodes Size bytes of code, which     **/
+/** must not change afterwards, into D[Size]: every offset  **/
+/** gets the opcode starting there, the two bytes after it  **/
+/** and the opcode's cycles. The last two offsets can't see **/
+/** their whole operand and get Cycles=0, Exec6502() then   **/
+/** fetches them from memory as usual.                      **/
+/*************************************************************/
+void Decode6502(Decoded6502 *D,const byte *Code,int Size)
+{
+  int J;
+
+  for(J=0;J<Size;J++)
+  {
+    D[J].Op=Code[J];
+    D[J].Cycles=J+2<Size? Cycles[Code[J]]:0;
+    D[J].Operand=J+2<Size? Code[J+1]|(Code[J+2]<<8):0;
+  }
+}
+
+/** Opcode dispatch ******************************************/
+/** Codes.h brackets each command with OP(code) and NEXT.   **/
+/** By default they turn into switch() cases. The threaded  **/
+/** code Exec6502() redefines them as labels, each followed **/
+/** by its own copy of the fetch and an indirect jump, so   **/
+/** every opcode predicts its successor separately.         **/
+/*************************************************************/
+#define OP(N)      case N:
+#define OP_DEFAULT default:
+#define NEXT       break
+
+/** DECODE_CACHE *********************************************/
+/** With this #define present, Exec6502() takes opcodes     **/
+/** found in R->Decoded[] pages (PRG-ROM) from there, with  **/
+/** their operands already fetched. UseDecoded.h switches   **/
+/** the operand macros over for a second copy of Codes.h,   **/
+/** UseFetched.h switches them back.                        **/
+/*************************************************************/
+#ifdef DECODE_CACHE
+#define DECODED(R) \
+  ((D=R->Decoded[R->PC.W>>11])&&(D+=R->PC.W&0x07FF)->Cycles)
+#endif
+
+/** Idle6502() ***********************************************/
+/** A loop pass that leaves registers, R->PC and R->Effects **/
+/** as they were finds the machine in the same state again, **/
+/** so does the next one, up to the end of RunCycles. Whole **/
+/** passes are skipped only while the last instruction of   **/
+/** the one after them still starts with RunCycles>0, which **/
+/** keeps the result identical to running them.             **/
+/*************************************************************/
+#if defined(EXEC6502) && defined(IDLE_SKIP)
+int Idle6502(M6502 *R,int RunCycles,word End)
+{
+  unsigned long long Now=R->Clock-RunCycles;
+  int Period,N;
+
+  if((R->PC.W==R->IdlePC)&&(R->Effects==R->IdleEffects)&&
+     (R->A==R->IdleA)&&(R->P==R->IdleP)&&(R->X==R->IdleX)&&
+     (R->Y==R->IdleY)&&(R->S==R->IdleS)&&!R->Trace&&
+     ((word)(R->Trap-R->PC.W)>=(word)(End-R->PC.W)))
+  {
+    Period=(int)(Now-R->IdleClock);
+    if((Period>0)&&(RunCycles>Period))
+    {
+      N=(RunCycles-1)/Period;
+      RunCycles-=N*Period;
+      R->Executed+=(unsigned long long)N*(R->Executed-R->IdleExecuted);
+      R->ICount-=N*(R->IdleICount-R->ICount);
+      R->IdleSkipped+=(unsigned long long)N*Period;
+      Now=R->Clock-RunCycles;
+    }
+  }
+
+  /* Remember this pass for the next time around */
+  R->IdlePC=R->PC.W;
+  R->IdleA=R->A;R->IdleP=R->P;R->IdleX=R->X;R->IdleY=R->Y;R->IdleS=R->S;
+  R->IdleICount=R->ICount;
+  R->IdleEffects=R->Effects;
+  R->IdleClock=Now;
+  R->IdleExecuted=R->Executed;
+  return(RunCycles);
+}
+#endif
+
 /** Exec6502() ***********************************************/
 /** This function will execute a single 6502 opcode. It     **/
 /** will then return next PC, and current register values   **/
-/** in R.                                                   **/
+/** in R. With THREADED_DISPATCH, the switch() version is   **/
+/** still built as ExecSwitch6502(), for comparison.        **/
 /*************************************************************/
 #ifdef EXEC6502
+#ifdef THREADED_DISPATCH
+int ExecSwitch6502(M6502 *R,int RunCycles)
+#else
 int Exec6502(M6502 *R,int RunCycles)
+#endif
 {
   register pair J,K;
   register byte I;
+#ifdef DECODE_CACHE
+  register const Decoded6502 *D;
+  register pair O;
+#endif
+
+  /* R->Clock stays at the end of the run until it returns */
+  R->Clock+=RunCycles;
 
   /* Execute requested number of cycles */
   while(RunCycles>0)
@@ -229,10 +364,27 @@ int Exec6502(M6502 *R,int RunCycles)
     if(R->PC.W==R->Trap) R->Trace=1;
     /* Call single-step debugger, exit if requested */
     if(R->Trace)
-      if(!Debug6502(R)) return(RunCycles);
+      if(!Debug6502(R)) break;
+#endif
+
+    R->Executed++;
+#ifdef DECODE_CACHE
+    if(DECODED(R))
+    {
+      R->PC.W++;
+      O.W=D->Operand;
+      RunCycles-=D->Cycles;
+      switch(D->Op)
+      {
+#include "UseDecoded.h"
+#include "Codes.h"
+#include "UseFetched.h"
+      }
+      continue;
+    }
 #endif
 
-    I=Op6502(R->PC.W++);
+    I=Op6502(R,R->PC.W++);
     RunCycles-=Cycles[I];
     switch(I)
     {
@@ -241,8 +393,103 @@ int Exec6502(M6502 *R,int RunCycles)
   }
 
   /* Return number of cycles left (<=0) */
+  R->Clock-=RunCycles;
+  R->Left=0;
   return(RunCycles);
 }
+
+#ifdef THREADED_DISPATCH
+#undef OP
+#undef OP_DEFAULT
+#undef NEXT
+
+#ifdef DEBUG
+#define TRAP_CHECK \
+  if(R->PC.W==R->Trap) R->Trace=1; \
+  if(R->Trace&&!Debug6502(R)) goto Exit;
+#else
+#define TRAP_CHECK
+#endif
+
+#ifdef DECODE_CACHE
+#define FETCH_DECODED \
+  if(DECODED(R)) \
+  { \
+    R->PC.W++; \
+    O.W=D->Operand; \
+    RunCycles-=D->Cycles; \
+    goto *DecodedLabels[D->Op]; \
+  }
+#else
+#define FETCH_DECODED
+#endif
+
+#define OP(N)      Op_##N:
+#define OP_DEFAULT Op_Default:
+#define NEXT \
+  if(RunCycles<=0) goto Exit; \
+  TRAP_CHECK \
+  R->Executed++; \
+  FETCH_DECODED \
+  I=Op6502(R,R->PC.W++); \
+  RunCycles-=Cycles[I]; \
+  goto *Labels[I]
+
+int Exec6502(M6502 *R,int RunCycles)
+{
+#define LABEL(N) &&Op_##N
+  static const void * const Labels[256] =
+  {
+#include "Labels.h"
+  };
+#undef LABEL
+#ifdef DECODE_CACHE
+#define LABEL(N) &&Dc_##N
+  static const void * const DecodedLabels[256] =
+  {
+#include "Labels.h"
+  };
+#undef LABEL
+  register const Decoded6502 *D;
+  register pair O;
+#endif
+  register pair J,K;
+  register byte I;
+
+  /* R->Clock stays at the end of the run until it returns */
+  R->Clock+=RunCycles;
+
+  /* Fetch the first opcode, every command fetches its own */
+  /* successor until the cycles run out                    */
+  NEXT;
+
+#include "Codes.h"
+
+#ifdef DECODE_CACHE
+#undef OP
+#undef OP_DEFAULT
+#define OP(N)      Dc_##N:
+#define OP_DEFAULT Dc_Default:
+#include "UseDecoded.h"
+#include "Codes.h"
+#include "UseFetched.h"
+#endif
+
+  /* OP_DEFAULT in Codes.h ends with NEXT, so all commands */
+  /* get here through NEXT, once the cycles run out        */
+Exit:
+  R->Clock-=RunCycles;
+  R->Left=0;
+  return(RunCycles);
+}
+
+#undef OP
+#undef OP_DEFAULT
+#undef NEXT
+#define OP(N)      case N:
+#define OP_DEFAULT default:
+#define NEXT       break
+#endif /* THREADED_DISPATCH */
 #endif /* EXEC6502 */
 
 /** Int6502() ************************************************/
@@ -263,8 +510,8 @@ void Int6502(M6502 *R,byte Type)
     R->P&=~D_FLAG;
     if(R->IAutoReset&&(Type==R->IRequest)) R->IRequest=INT_NONE;
     if(Type==INT_NMI) J.W=0xFFFA; else { R->P|=I_FLAG;J.W=0xFFFE; }
-    R->PC.B.l=Rd6502(J.W++);
-    R->PC.B.h=Rd6502(J.W);
+    R->PC.B.l=Rd6502(R,J.W++);
+    R->PC.B.h=Rd6502(R,J.W);
   }
 }
 
@@ -293,8 +540,9 @@ word Run6502(M6502 *R)
       if(!Debug6502(R)) return(R->PC.W);
 #endif
 
-    I=Op6502(R->PC.W++);
+    I=Op6502(R,R->PC.W++);
     R->ICount-=Cycles[I];
+    R->Executed++;
     switch(I)
     {
 #include "Codes.h"
@@ -16,10 +16,15 @@
 
 #ifdef __cplusplus
 extern "C" {
+#pragma push_macro("register")
+#define register               /* Dropped from C++17         */
 #endif
 
                                /* Compilation options:       */
-/* #define FAST_RDOP */        /* Separate Op6502()/Rd6502() */
+/* #define FAST_RDOP */        /* Op6502() reads R->Page[]   */
+/* #define THREADED_DISPATCH */ /* Exec6502() uses goto *label */
+/* #define DECODE_CACHE */     /* Exec6502() uses R->Decoded[] */
+/* #define IDLE_SKIP */        /* Exec6502() skips idle loops */
 #define DEBUG             /* Compile debugging version  */
 #define LSB_FIRST         /* Compile for low-endian CPU */
 
@@ -66,6 +71,16 @@ typedef union
   word W;
 } pair;
 
+/** Decoded6502 **********************************************/
+/** One pre-decoded instruction, see Decode6502().          **/
+/*************************************************************/
+typedef struct
+{
+  byte Op;            /* Opcode                              */
+  byte Cycles;        /* Its cycles, 0 if not decoded        */
+  word Operand;       /* Two bytes following the opcode      */
+} Decoded6502;
+
 typedef struct
 {
   byte A,P,X,Y,S;     /* CPU registers and program counter   */
@@ -81,6 +96,26 @@ typedef struct
   word Trap;          /* Set Trap to address to trace from   */
   byte Trace;         /* Set Trace=1 to start tracing        */
   void *User;         /* Arbitrary user data (ID,RAM*,etc.)  */
+  const byte * const *Page; /* 32 2kB pages for FAST_RDOP      */
+  unsigned long long Executed; /* Instructions executed so far */
+  const Decoded6502 * const *Decoded; /* 32 2kB pages for DECODE_CACHE, */
+                      /* NULL for pages that aren't ROM      */
+  unsigned long long Clock; /* Cycles run so far, see Exec6502()  */
+  int Left;           /* Cycles left in the run as absolute  */
+                      /* and indirect accesses see it, so    */
+                      /* R->Clock-R->Left is the cycle the   */
+                      /* current instruction ends at; 0      */
+                      /* outside Exec6502(). Taking as much  */
+                      /* off both ends the run sooner.       */
+  unsigned int Effects; /* Machine counts writes and reads   */
+                      /* that change its state, IDLE_SKIP    */
+  unsigned long long IdleSkipped; /* Cycles skipped in idle loops */
+
+  word IdlePC;        /* Private, last pass of a loop as     */
+  byte IdleA,IdleP,IdleX,IdleY,IdleS; /* seen by Idle6502()   */
+  int IdleICount;     /* Private, don't touch                */
+  unsigned int IdleEffects; /* Private, don't touch          */
+  unsigned long long IdleClock,IdleExecuted; /* Private      */
 } M6502;
 
 /** Reset6502() **********************************************/
@@ -93,12 +128,45 @@ void Reset6502(register M6502 *R);
 /** Exec6502() ***********************************************/
 /** This function will execute given number of 6502 cycles. **/
 /** It will then return the number of cycles left, possibly **/
-/** negative, and current register values in R.             **/
+/** negative, and current register values in R. R->Clock is **/
+/** ahead by the cycles left while it runs, R->Clock minus  **/
+/** RunCycles being the current cycle. Rd6502()/Wr6502()    **/
+/** calls that may reach I/O find it as R->Clock-R->Left.   **/
 /*************************************************************/
 #ifdef EXEC6502
 int Exec6502(register M6502 *R,register int RunCycles);
 #endif
 
+/** ExecSwitch6502() *****************************************/
+/** With THREADED_DISPATCH, Exec6502() jumps straight from  **/
+/** one command to the next through a table of labels (GCC  **/
+/** and Clang only). This is the same function built with   **/
+/** the plain switch() dispatcher, kept for benchmarking.   **/
+/*************************************************************/
+#if defined(EXEC6502) && defined(THREADED_DISPATCH)
+int ExecSwitch6502(register M6502 *R,register int RunCycles);
+#endif
+
+/** Idle6502() ***********************************************/
+/** With IDLE_SKIP, a taken branch or JMP going back at     **/
+/** most IDLE_LOOP_BYTES from End, the address after it,    **/
+/** calls this function. If the previous pass through the   **/
+/** loop left the registers as they were and R->Effects     **/
+/** unchanged, every later pass will be the same, so it     **/
+/** charges all whole passes that fit into RunCycles at     **/
+/** once and returns the cycles left.                       **/
+/*************************************************************/
+#define IDLE_LOOP_BYTES 16
+#if defined(EXEC6502) && defined(IDLE_SKIP)
+int Idle6502(register M6502 *R,register int RunCycles,register word End);
+#endif
+
+/** Decode6502() *********************************************/
+/** This function pre-decodes Size bytes of immutable code  **/
+/** into D[Size], for use through R->Decoded[] pages.       **/
+/*************************************************************/
+void Decode6502(register Decoded6502 *D,register const byte *Code,register int Size);
+
 /** Int6502() ************************************************/
 /** This function will generate interrupt of a given type.  **/
 /** INT_NMI will cause a non-maskable interrupt. INT_IRQ    **/
@@ -117,14 +185,16 @@ word Run6502(register M6502 *R);
 
 /** Rd6502()/Wr6502/Op6502() *********************************/
 /** These functions are called when access to RAM occurs.   **/
-/** They allow to control memory access. Op6502 is the same **/
+/** They get the CPU, so R->User can point to the emulated  **/
+/** machine owning it. Op6502 is the same                   **/
 /** as Rd6502, but used to read *opcodes* only, when many   **/
-/** checks can be skipped to make it fast. It is only       **/
-/** required if there is a #define FAST_RDOP.               **/
+/** checks can be skipped to make it fast. With #define     **/
+/** FAST_RDOP it is a single load from R->Page[A>>11],      **/
+/** which must then map all 32 pages, I/O ones included.    **/
 /************************************ TO BE WRITTEN BY USER **/
-void Wr6502(register word Addr,register byte Value);
-byte Rd6502(register word Addr);
-byte Op6502(register word Addr);
+void Wr6502(register M6502 *R,register word Addr,register byte Value);
+byte Rd6502(register M6502 *R,register word Addr);
+byte Op6502(register M6502 *R,register word Addr);
 
 /** Debug6502() **********************************************/
 /** This function should exist if DEBUG is #defined. When   **/
@@ -153,6 +223,7 @@ byte Loop6502(register M6502 *R);
 byte Patch6502(register byte Op,register M6502 *R);
 
 #ifdef __cplusplus
+#pragma pop_macro("register")
 }
 #endif
 #endif /* M6502_H */
@@ -0,0 +1,17 @@
+/** M6502: portable 6502 emulator ****************************/
+/**                                                         **/
+/**                       UseDecoded.h                      **/
+/**                                                         **/
+/** This file makes the operand macros read from O, which   **/
+/** Exec6502() loads from a Decoded6502 entry. PC advances  **/
+/** exactly as when fetching. It is included from M6502.c   **/
+/** before a DECODE_CACHE copy of Codes.h.                  **/
+/**                                                         **/
+/*************************************************************/
+
+#undef M_RDOP
+#undef M_RDREL
+#undef M_LDWORD
+#define M_RDOP		(R->PC.W++,O.B.l)
+#define M_RDREL		(offset)O.B.l
+#define M_LDWORD(Rg)	Rg.W=O.W;R->PC.W+=2
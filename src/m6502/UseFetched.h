@@ -0,0 +1,16 @@
+/** M6502: portable 6502 emulator ****************************/
+/**                                                         **/
+/**                       UseFetched.h                      **/
+/**                                                         **/
+/** This file restores the operand macros to fetching from  **/
+/** code with Op6502(), after UseDecoded.h. It is included  **/
+/** from M6502.c.                                           **/
+/**                                                         **/
+/*************************************************************/
+
+#undef M_RDOP
+#undef M_RDREL
+#undef M_LDWORD
+#define M_RDOP		Op6502(R,R->PC.W++)
+#define M_RDREL		(offset)Op6502(R,R->PC.W)
+#define M_LDWORD(Rg)	Rg.B.l=Op6502(R,R->PC.W++);Rg.B.h=Op6502(R,R->PC.W++)
@@ -0,0 +1,153 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <iterator>
+#ifdef DENDY_HEADLESS
+#include <strings.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "console.h"
+#include "audio_ring.h"
+#include "rate_control.h"
+#include "screen_converter.h"
+#include "MiniFB.h"
+#ifdef DENDY_HEADLESS
+#include "audio_sink.h"
+#else
+#include "win32/audio.h"
+#endif
+
+static dendy::Console console;
+static dendy::ScreenConverter converter;
+
+// A quarter of a second of samples between the emulation and the device
+static dendy::AudioRing audio(44100 / 4);
+
+// Buffered in the ring when frames are paced by the audio device, unless given
+static const unsigned DEFAULT_LATENCY_MS = 40;
+
+#ifdef _WIN32
+extern "C" void HandleInput(WPARAM wParam, BOOL isKeyDown) {
+}
+#endif
+
+static uint8_t read_buttons(const char *key_status) {
+    uint8_t buttons = 0;
+    if (key_status['Z']) buttons |= dendy::BUTTON_A;
+    if (key_status['X']) buttons |= dendy::BUTTON_B;
+    if (key_status[VK_SPACE]) buttons |= dendy::BUTTON_SELECT;
+    if (key_status[VK_RETURN]) buttons |= dendy::BUTTON_START;
+    if (key_status[VK_UP]) buttons |= dendy::BUTTON_UP;
+    if (key_status[VK_DOWN]) buttons |= dendy::BUTTON_DOWN;
+    if (key_status[VK_LEFT]) buttons |= dendy::BUTTON_LEFT;
+    if (key_status[VK_RIGHT]) buttons |= dendy::BUTTON_RIGHT;
+    return buttons;
+}
+
+// The window expands SCREEN through its own palette, handed the resolved colours only when they change
+static void update_palette() {
+    if (converter.set_palette(console.SCREEN_PALETTE, console.SCREEN_MASK)) {
+        mfb_set_pallete_array(converter.palette(), 0, 32);
+    }
+}
+
+// Hands the samples of the frame to the audio thread. A file wants every one of them, so then it waits for room
+// rather than letting the ring drop them.
+static void push_audio(const bool wait) {
+    int16_t samples[1024];
+    while (const size_t count = console.apu.read_samples(samples, std::size(samples))) {
+        if (wait) audio.drain(audio.capacity() - count);
+        audio.write(samples, count);
+    }
+}
+
+int main(const int argc, char **argv) {
+#ifdef DENDY_HEADLESS
+    const int scale = 1;
+
+    if (!argv[1]) {
+        printf("Usage: dendy <rom.bin> [frames] [input_script|-] [dump_path|-] [audio.wav|null] [latency_ms]\n");
+        return EXIT_FAILURE;
+    }
+
+    const unsigned frames = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+    const char *input_script = argc > 3 && strcmp(argv[3], "-") != 0 ? argv[3] : NULL;
+    const char *dump_path = argc > 4 && strcmp(argv[4], "-") != 0 ? argv[4] : NULL;
+
+    // Samples go into a WAV file as fast as they come, or to a null device that plays them in real time and
+    // paces the frames, or aren't made at all
+    const char *audio_path = argc > 5 && strcmp(argv[5], "null") != 0 ? argv[5] : NULL;
+    const bool audio_enabled = argc > 5;
+    const unsigned latency_ms = argc > 6 ? strtoul(argv[6], NULL, 10) : DEFAULT_LATENCY_MS;
+
+    if (!mfb_headless_setup(frames, input_script, dump_path))
+        return EXIT_FAILURE;
+
+    // Unless every frame is dumped (raw stream or a %u pattern), only the last one of a limited run is looked at
+    const size_t length = dump_path ? strlen(dump_path) : 0;
+    const bool skip_render = frames && (!dump_path || !strchr(dump_path, '%') && length > 4 &&
+                                                          !strcasecmp(dump_path + length - 4, ".ppm"));
+    unsigned frame = 0;
+#else
+    const int scale = argc > 2 ? atoi(argv[2]) : 4;
+    const unsigned latency_ms = argc > 3 ? strtoul(argv[3], NULL, 10) : DEFAULT_LATENCY_MS;
+
+    if (!argv[1]) {
+        printf("Usage: dendy.exe <rom.bin> [scale_factor] [latency_ms]\n");
+        return EXIT_FAILURE;
+    }
+#endif
+
+    if (!console.load(argv[1]))
+        return EXIT_FAILURE;
+
+    if (!mfb_open("Dendy", NES_WIDTH, NES_HEIGHT, scale))
+        return EXIT_FAILURE;
+
+    const char *key_status = mfb_keystatus();
+
+    console.reset();
+    dendy::RateControl rate_control(audio, console.apu.sample_rate(), latency_ms);
+#ifdef DENDY_HEADLESS
+    dendy::AudioSink sink;
+    if (!audio_enabled)
+        console.apu.set_sample_rate(0);
+    else if (!sink.open(audio, console.apu.sample_rate(), audio_path))
+        return EXIT_FAILURE;
+    const bool lossless = audio_path != NULL;
+    const bool paced = audio_enabled && !lossless;
+#else
+    // A frame of latency for drawing on another core, the window shows frames a step behind anyway
+    console.use_pipeline(true);
+
+    // Without a sound card the window falls back to its own frame limiter
+    const bool lossless = false;
+    const bool paced = StartSound(&audio);
+#endif
+
+    do {
+#ifdef DENDY_HEADLESS
+        if (skip_render) console.set_render_skip(++frame < frames);
+#endif
+        console.set_buttons(read_buttons(key_status));
+        console.frame();
+        push_audio(lossless);
+        if (paced) console.apu.set_resampling_ratio(rate_control.pace());
+        update_palette();
+    } while (mfb_update(console.SCREEN, paced ? 0 : 60) != -1);
+
+#ifdef DENDY_HEADLESS
+    if (audio_enabled) {
+        const double latency = rate_control.latency();
+        sink.close();
+        fprintf(stderr, "audio: %llu samples played, %llu underrun, %llu overrun, %.1f ms buffered, ratio %.5f\n",
+                static_cast<unsigned long long>(sink.samples()), static_cast<unsigned long long>(audio.underruns()),
+                static_cast<unsigned long long>(audio.overruns()), latency, rate_control.ratio());
+    }
+#endif
+    mfb_close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,224 @@
+#include "mapper.h"
+
+#include <cstring>
+
+#include "ppu.h"
+
+namespace dendy {
+
+bool Mapper::supported(const uint8_t number) {
+    switch (number) {
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+        case 7:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void Mapper::reset(const RomImage &rom, const uint8_t *chr_ram) {
+    prg_rom = rom.prg;
+    prg_banks = static_cast<unsigned>(rom.prg_size / 0x2000);
+    chr_rom = rom.chr ? rom.chr : chr_ram;
+    chr_banks = rom.chr ? static_cast<unsigned>(rom.chr_size / 0x400) : 8;
+    mirroring = rom.mirroring ? MIRROR_VERTICAL : MIRROR_HORIZONTAL;
+    irq_latch = irq_counter = 0;
+    irq_reload = irq_enabled = irq_pending = false;
+
+    // NROM-128 mirrors its 16K, everything else starts from the first banks unless the board fixes others
+    map_prg(0, 0, 4);
+    map_chr(0, 0, 8);
+
+    switch (rom.mapper) {
+        case 1:
+            write_handler = &Mapper::write_mmc1;
+            shift = shift_count = 0;
+            control = 0x0C; // Last 16K fixed at $C000
+            chr_bank0 = chr_bank1 = prg_bank = 0;
+            update_mmc1();
+            break;
+        case 2:
+            write_handler = &Mapper::write_uxrom;
+            map_prg(2, prg_banks - 2, 2);
+            break;
+        case 3:
+            write_handler = &Mapper::write_cnrom;
+            break;
+        case 4: {
+            write_handler = &Mapper::write_mmc3;
+            static constexpr uint8_t power_on[8] = { 0, 2, 4, 5, 6, 7, 0, 1 };
+            memcpy(registers, power_on, sizeof(registers));
+            bank_select = 0;
+            update_mmc3();
+            break;
+        }
+        case 7:
+            write_handler = &Mapper::write_axrom;
+            mirroring = MIRROR_SINGLE_LOW;
+            break;
+        default:
+            write_handler = &Mapper::write_none;
+            break;
+    }
+}
+
+void Mapper::map_prg(const unsigned slot, const unsigned bank, const unsigned count) {
+    for (unsigned i = 0; i < count; ++i) prg[slot + i] = &prg_rom[(bank + i) % prg_banks * 0x2000];
+}
+
+void Mapper::map_chr(const unsigned slot, const unsigned bank, const unsigned count) {
+    for (unsigned i = 0; i < count; ++i) chr[slot + i] = &chr_rom[(bank + i) % chr_banks * 0x400];
+}
+
+// MMC1 (SxROM): registers are loaded a bit at a time through a 5-bit shift register, bit 7 resets it
+void Mapper::write_mmc1(const uint16_t address, const uint8_t value) {
+    if (value & BIT_7) {
+        shift = shift_count = 0;
+        control |= 0x0C;
+        update_mmc1();
+        return;
+    }
+
+    shift |= (value & 1) << shift_count;
+    if (++shift_count < 5) return;
+
+    switch (address >> 13 & 3) {
+        case 0: control = shift; break;
+        case 1: chr_bank0 = shift; break;
+        case 2: chr_bank1 = shift; break;
+        case 3: prg_bank = shift; break;
+    }
+    shift = shift_count = 0;
+    update_mmc1();
+}
+
+void Mapper::update_mmc1() {
+    static constexpr uint8_t mirrorings[4] = {
+        MIRROR_SINGLE_LOW, MIRROR_SINGLE_HIGH, MIRROR_VERTICAL, MIRROR_HORIZONTAL,
+    };
+    mirroring = mirrorings[control & 3];
+
+    // 512K boards (SUROM) take the 256K half from bit 4 of the CHR register, in 16K banks
+    const unsigned outer = prg_banks > 32 ? chr_bank0 & 0x10 : 0;
+    const unsigned bank = prg_bank & 0x0F | outer;
+    switch (control >> 2 & 3) {
+        case 0:
+        case 1: // 32K
+            map_prg(0, (bank & ~1) * 2, 4);
+            break;
+        case 2: // First 16K fixed at $8000
+            map_prg(0, outer * 2, 2);
+            map_prg(2, bank * 2, 2);
+            break;
+        case 3: // Last 16K fixed at $C000
+            map_prg(0, bank * 2, 2);
+            map_prg(2, (0x0F | outer) * 2, 2);
+            break;
+    }
+
+    if (control & BIT_4) { // Two 4K banks
+        map_chr(0, chr_bank0 * 4, 4);
+        map_chr(4, chr_bank1 * 4, 4);
+    } else {
+        map_chr(0, (chr_bank0 & ~1) * 4, 8);
+    }
+}
+
+// UxROM: 16K at $8000, the last one fixed at $C000
+void Mapper::write_uxrom(const uint16_t address, const uint8_t value) {
+    map_prg(0, value * 2, 2);
+}
+
+// CNROM: 8K of CHR
+void Mapper::write_cnrom(const uint16_t address, const uint8_t value) {
+    map_chr(0, value * 8, 8);
+}
+
+// MMC3 (TxROM): $8000 picks one of R0-R7 and the PRG and CHR modes, $8001 sets it, $A000 the mirroring.
+// $C000 sets the scanline counter's latch, $C001 has it reloaded, $E000 disables and acknowledges the IRQ and
+// $E001 enables it. PRG-RAM protection ($A001) isn't emulated.
+void Mapper::write_mmc3(const uint16_t address, const uint8_t value) {
+    switch (address & 0xE001) {
+        case 0x8000:
+            bank_select = value;
+            update_mmc3();
+            break;
+        case 0x8001:
+            registers[bank_select & 7] = value;
+            update_mmc3();
+            break;
+        case 0xA000:
+            mirroring = value & 1 ? MIRROR_HORIZONTAL : MIRROR_VERTICAL;
+            break;
+        case 0xC000:
+            irq_latch = value;
+            break;
+        case 0xC001:
+            irq_counter = 0;
+            irq_reload = true;
+            break;
+        case 0xE000:
+            irq_enabled = irq_pending = false;
+            break;
+        case 0xE001:
+            irq_enabled = true;
+            break;
+    }
+}
+
+void Mapper::clock_scanlines(uint64_t count) {
+    if (!count || !counts_scanlines()) return;
+
+    // The first clock reloads an empty counter. A latch of 0 keeps it at 0, raising the IRQ on every clock.
+    if (!irq_counter || irq_reload) {
+        irq_counter = irq_latch;
+        irq_reload = false;
+        --count;
+        if (!irq_counter) {
+            if (irq_enabled) irq_pending = true;
+            return;
+        }
+    }
+    if (count < irq_counter) {
+        irq_counter -= static_cast<uint8_t>(count);
+        return;
+    }
+
+    // Down to 0, then round again from the latch every latch + 1 clocks
+    count -= irq_counter;
+    if (irq_enabled) irq_pending = true;
+    irq_counter = count ? static_cast<uint8_t>(irq_latch - (count - 1) % (irq_latch + 1u)) : 0;
+}
+
+uint64_t Mapper::scanlines_to_irq() const {
+    if (!counts_scanlines() || !irq_enabled || irq_pending) return NEVER;
+    if (!irq_counter || irq_reload) return irq_latch + 1u;
+    return irq_counter;
+}
+
+void Mapper::update_mmc3() {
+    // R6 at $8000 or $C000, the second to last bank at the other one, R7 at $A000 and the last one at $E000
+    const unsigned swap = bank_select & BIT_6 ? 2 : 0;
+    map_prg(0 ^ swap, registers[6]);
+    map_prg(2 ^ swap, prg_banks - 2);
+    map_prg(1, registers[7]);
+    map_prg(3, prg_banks - 1);
+
+    // 2K banks R0 and R1, 1K banks R2-R5, in either pattern table
+    const unsigned invert = bank_select & BIT_7 ? 4 : 0;
+    map_chr(0 ^ invert, registers[0] & ~1, 2);
+    map_chr(2 ^ invert, registers[1] & ~1, 2);
+    for (unsigned i = 0; i < 4; ++i) map_chr(4 + i ^ invert, registers[2 + i]);
+}
+
+// AxROM: 32K of PRG, bit 4 picks the nametable all four show
+void Mapper::write_axrom(const uint16_t address, const uint8_t value) {
+    map_prg(0, (value & 7) * 4, 4);
+    mirroring = value & BIT_4 ? MIRROR_SINGLE_HIGH : MIRROR_SINGLE_LOW;
+}
+
+}
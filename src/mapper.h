@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "rom_image.h"
+
+namespace dendy {
+
+// Cartridge board: what writes to $8000-$FFFF do to the banks, and the IRQ some boards raise. Banks are kept as
+// pointer tables, PRG in 8K and CHR in 1K, the smallest the supported boards switch; Console points the CPU
+// pages and the PPU at them after every write, so reads never go through the mapper. Boards supported, by iNES
+// number: NROM (0), MMC1 (1), UxROM (2), CNROM (3), MMC3 (4) and AxROM (7).
+class Mapper {
+public:
+    static constexpr uint64_t NEVER = UINT64_MAX;
+
+    static bool supported(uint8_t number);
+
+    // Power-on state of the board rom is for. CHR-RAM, for images without CHR-ROM, is chr_ram (8K).
+    void reset(const RomImage &rom, const uint8_t *chr_ram);
+
+    // A write to $8000-$FFFF
+    void write(const uint16_t address, const uint8_t value) { (this->*write_handler)(address, value); }
+
+    // MMC3 scanline counter, clocked by the PPU once a rendering line, see Console::run_scanline_counter()
+    bool counts_scanlines() const { return write_handler == &Mapper::write_mmc3; }
+    void clock_scanlines(uint64_t count);
+
+    // Clocks left until the counter raises the IRQ as things stand, NEVER if it won't
+    uint64_t scanlines_to_irq() const;
+
+    // IRQ line, up until acknowledged
+    bool irq() const { return irq_pending; }
+
+    const uint8_t *prg[4] = {}; // $8000, $A000, $C000 and $E000
+    const uint8_t *chr[8] = {}; // $0000-$1FFF, into chr_rom
+    const uint8_t *chr_rom = nullptr; // CHR-ROM, or the CHR-RAM
+    uint8_t mirroring = 0; // MIRROR_*
+
+private:
+    using handler = void (Mapper::*)(uint16_t address, uint8_t value);
+
+    void write_none(uint16_t address, uint8_t value) {}
+    void write_mmc1(uint16_t address, uint8_t value);
+    void write_uxrom(uint16_t address, uint8_t value);
+    void write_cnrom(uint16_t address, uint8_t value);
+    void write_mmc3(uint16_t address, uint8_t value);
+    void write_axrom(uint16_t address, uint8_t value);
+
+    // Sets the banks from the board's registers
+    void update_mmc1();
+    void update_mmc3();
+
+    // Maps count consecutive banks of PRG (8K) or CHR (1K) from bank on, at slot on. Bank numbers wrap
+    // around the size of the ROM, as the unconnected high bits of the registers would.
+    void map_prg(unsigned slot, unsigned bank, unsigned count = 1);
+    void map_chr(unsigned slot, unsigned bank, unsigned count = 1);
+
+    handler write_handler = &Mapper::write_none;
+    const uint8_t *prg_rom = nullptr;
+    unsigned prg_banks = 0; // 8K
+    unsigned chr_banks = 0; // 1K
+
+    // MMC1: serial port, and the four registers it loads
+    uint8_t shift = 0;
+    uint8_t shift_count = 0;
+    uint8_t control = 0;
+    uint8_t chr_bank0 = 0;
+    uint8_t chr_bank1 = 0;
+    uint8_t prg_bank = 0;
+
+    // MMC3: register $8001 writes to, PRG and CHR modes, and R0-R7
+    uint8_t bank_select = 0;
+    uint8_t registers[8] = {};
+
+    // MMC3 scanline counter: reloaded from the latch when it is 0 or $C001 asked for it, otherwise counting
+    // down, raising the IRQ when it ends up at 0
+    uint8_t irq_latch = 0;
+    uint8_t irq_counter = 0;
+    bool irq_reload = false;
+    bool irq_enabled = false;
+    bool irq_pending = false;
+};
+
+}
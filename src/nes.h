@@ -12,9 +12,12 @@
 #define NES_HEIGHT 240
 
 #define VISIBLE_SCANLINES NES_HEIGHT
-#define NTSC_SCANLINES_PER_FRAME 261
+#define VBLANK_SCANLINE 241
+#define PRERENDER_SCANLINE 261
+#define NTSC_SCANLINES_PER_FRAME 262
 
-#define CPU_CYCLES_PER_SCANLINE 114 // ppu / 3
+#define PPU_DOTS_PER_SCANLINE 341
+#define PPU_DOTS_PER_CPU_CYCLE 3 // NTSC
 
 enum {
     BIT_7 = 1 << 7,
@@ -27,13 +30,6 @@ enum {
     BIT_0 = 1
 };
 
-extern uint8_t RAM[2048];
-extern uint8_t ROM[1024 << 10];
-
-
-extern uint8_t VRAM[16384];
-extern uint8_t OAM[256];
-extern uint8_t PALETTE[64];
 // RGB888 palette
 static const int nes_palette_raw[64] = {
     0x6D6D6D, 0x002492, 0x0000DB, 0x6D49DB,
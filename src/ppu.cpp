@@ -0,0 +1,317 @@
+#include "ppu.h"
+
+#include <cstring>
+
+namespace dendy {
+
+enum {
+    PPU_CTRL,
+    PPU_MASK,
+    PPU_STATUS,
+
+    OAM_ADDR,
+    OAM_DATA,
+
+    PPU_SCROLL,
+
+    PPU_ADDRESS,
+    PPU_DATA,
+
+    OAM_DMA = 0x4014
+};
+
+inline void PPU::increment_address() {
+    v = v + address_step & 0x3fff;
+}
+
+void PPU::increment_y() {
+    if ((v & 0x7000) != 0x7000) {
+        v += 0x1000; // Fine Y
+        return;
+    }
+
+    v &= ~0x7000;
+    uint16_t coarse_y = v >> 5 & 31;
+    if (coarse_y == 29) {
+        coarse_y = 0;
+        v ^= 0x0800; // Next nametable down
+    } else if (coarse_y == 31) {
+        coarse_y = 0; // Attribute rows used as tiles wrap in the same nametable
+    } else {
+        ++coarse_y;
+    }
+    v = v & ~0x03E0 | coarse_y << 5;
+}
+
+ScanlineState PPU::scanline_state() const {
+    return {
+        .v = v,
+        .fine_x = x,
+        .background_enabled = background_enabled,
+        .sprites_enabled = sprites_enabled,
+        .background_left = background_left,
+        .sprites_left = sprites_left,
+        .sprite_height = sprite_height,
+        .background_tiles = background_tiles,
+        .sprite_tiles = sprite_tiles,
+    };
+}
+
+inline void PPU::vram_write(const uint16_t address, const uint8_t value) {
+    if (address < 0x2000) {
+        // CHR-ROM ignores writes
+        if (chr_rom == CHRRAM) {
+            const uint16_t offset = chr[address >> 10] - CHRRAM + (address & 0x3FF);
+            CHRRAM[offset] = value;
+            chr_ram_written(offset);
+            ++memory_writes;
+        }
+    } else if (address < 0x3F00) {
+        VRAM[nametable(address)] = value;
+        ++memory_writes;
+    } else {
+        // printf("!!! Writing palette %x %x ?\n", address  - 0x3F00, value);
+        // Colour 0 of the sprite palettes is the backdrop, $3F10/$3F14/$3F18/$3F1C mirror $3F00/$3F04/...
+        // Frames are coloured from PALETTE once drawn, see ScreenConverter.
+        const uint8_t index = address & 0x1F;
+        PALETTE[index & 3 ? index : index & 0x0F] = value;
+    }
+    increment_address();
+}
+
+
+void PPU::write(const uint16_t address, const uint8_t value) {
+    // printf("ppu_write %x %x\n", address, value);
+    switch (address & 7) {
+        case PPU_CTRL:
+            t = t & ~0x0C00 | (value & 3) << 10; // Nametable (0 = $2000; 1 = $2400; 2 = $2800; 3 = $2C00)
+
+            address_step = value & BIT_2 ? 32 : 1;
+            if (sprite_height != (value & BIT_5 ? 16 : 8)) {
+                sprites_dirty = true;
+                ++memory_writes;
+            }
+            sprite_height = value & BIT_5 ? 16 : 8;
+
+            sprite_tiles = sprite_height == 8 && value & BIT_3 ? 256 : 0;
+            background_tiles = value & BIT_4 ? 256 : 0;
+
+            nmi_enabled = value & BIT_7 ? 1 : 0;
+            break;
+        case PPU_MASK:
+            mask = value;
+            background_left = value & BIT_1 ? 1 : 0;
+            sprites_left = value & BIT_2 ? 1 : 0;
+            background_enabled = value & BIT_3 ? 1 : 0;
+            sprites_enabled = value & BIT_4 ? 1 : 0;
+            break;
+        case PPU_SCROLL:
+            if (w ^= 1) {
+                t = t & ~0x001F | value >> 3;
+                x = value & 7;
+            } else {
+                t = t & ~0x73E0 | (value & 7) << 12 | (value & 0xF8) << 2;
+            }
+            break;
+        case PPU_ADDRESS: // VRAM Address Register
+            if (w ^= 1) {
+                t = t & 0x00FF | (value & 0x3F) << 8;
+            } else {
+                t = t & 0xFF00 | value;
+                v = t;
+            }
+            break;
+        case PPU_DATA: // VRAM Read/Write Data Register
+            vram_write(v, value);
+            break;
+        case OAM_ADDR:
+            // printf("OAM address = 0x%04X\n", value);
+            oam_address = value;
+            break;
+        case OAM_DATA:
+            // printf("OAM data = 0x%04X\n", value);
+            OAM[oam_address++] = value;
+            sprites_dirty = true;
+            ++memory_writes;
+            break;
+    }
+}
+
+inline uint8_t PPU::vram_read(const uint16_t address) {
+    if (address < 0x2000) {
+        return chr[address >> 10][address & 0x3FF];
+    }
+
+    if (address < 0x3F00) {
+        const uint8_t result = read_buffer;
+        read_buffer = VRAM[nametable(address)];
+        increment_address();
+        return result;
+    }
+
+    // Palette reads aren't buffered, the buffer gets the nametable byte underneath ($2F00-$2FFF) instead
+    const uint8_t index = address & 0x1F;
+    read_buffer = VRAM[nametable(address - 0x1000)];
+    increment_address();
+    return PALETTE[index & 3 ? index : index & 0x0F];
+}
+
+uint8_t PPU::read(const uint16_t address) {
+    // printf("ppu_read(%x)\n", address);
+    switch (address & 7) {
+        case PPU_STATUS: { // PPU Status Register
+            const uint8_t ppu_status = status;
+            w = 0;
+            status &= ~BIT_7;
+            return ppu_status;
+        }
+        case PPU_DATA:
+            return vram_read(v);
+        case OAM_DATA:
+            return OAM[oam_address];
+    }
+    return 0xff;
+}
+
+void PPU::oam_dma(const uint8_t *page) {
+    memcpy(OAM, page, sizeof(OAM));
+    sprites_dirty = true;
+    ++memory_writes;
+}
+
+void PPU::map(const uint8_t *chr_rom, const uint8_t *const chr[8], const uint8_t mirroring) {
+    if (this->chr_rom == chr_rom && mapped(chr, mirroring)) return;
+    this->chr_rom = chr_rom;
+    std::copy(chr, chr + 8, this->chr);
+    this->mirroring = mirroring;
+    ++memory_writes;
+}
+
+void PPU::chr_ram_written(const uint16_t offset) {
+    const uint8_t *bank = &CHRRAM[offset & ~0x3FF];
+    for (unsigned slot = 0; slot < 8; ++slot) {
+        if (chr[slot] == bank) {
+            tile_dirty[slot * 64 + (offset & 0x3FF) / 16] = 1;
+        } else if (tile_source[slot] == bank) {
+            tile_source[slot] = nullptr; // Switched away undecoded, all of it is decoded again if it comes back
+        }
+    }
+    tiles_dirty = true;
+}
+
+void PPU::save(PPUMemory &memory) const {
+    memcpy(memory.VRAM, VRAM, sizeof(memory.VRAM));
+    memcpy(memory.OAM, OAM, sizeof(memory.OAM));
+    memory.chr_rom = chr_rom == CHRRAM ? nullptr : chr_rom;
+    if (!memory.chr_rom) memcpy(memory.CHRRAM, CHRRAM, sizeof(memory.CHRRAM));
+    for (unsigned slot = 0; slot < 8; ++slot) memory.chr[slot] = static_cast<uint32_t>(chr[slot] - chr_rom);
+    memory.sprite_height = sprite_height;
+    memory.mirroring = mirroring;
+}
+
+void PPU::load(const PPUMemory &memory) {
+    memcpy(VRAM, memory.VRAM, sizeof(memory.VRAM));
+    mirroring = memory.mirroring;
+
+    if (sprite_height != memory.sprite_height || memcmp(OAM, memory.OAM, sizeof(OAM)) != 0) {
+        memcpy(OAM, memory.OAM, sizeof(OAM));
+        sprite_height = memory.sprite_height;
+        sprites_dirty = true;
+    }
+
+    chr_rom = memory.chr_rom ? memory.chr_rom : CHRRAM;
+    for (unsigned slot = 0; slot < 8; ++slot) chr[slot] = chr_rom + memory.chr[slot];
+    if (memory.chr_rom) return;
+
+    for (uint16_t tile = 0; tile < 512; ++tile) {
+        if (memcmp(&CHRRAM[tile * 16], &memory.CHRRAM[tile * 16], 16) != 0) {
+            memcpy(&CHRRAM[tile * 16], &memory.CHRRAM[tile * 16], 16);
+            chr_ram_written(tile * 16);
+        }
+    }
+}
+
+const SpriteLine &PPU::sprite_line(const unsigned scanline) {
+    if (sprites_dirty) update_sprite_lines();
+    return sprite_lines[scanline];
+}
+
+unsigned PPU::overflow_line(const unsigned scanline) {
+    if (sprites_dirty) update_sprite_lines();
+    return scanline < NES_HEIGHT ? overflow_lines[scanline] : NES_HEIGHT;
+}
+
+void PPU::update_sprite_lines() {
+    sprites_dirty = false;
+    for (SpriteLine &line : sprite_lines) {
+        line.count = 0;
+        line.overflow = false;
+    }
+
+    // A sprite shows up on the lines after its Y, those past the bottom are left out
+    for (uint8_t sprite = 0; sprite < 64; ++sprite) {
+        const unsigned top = OAM[sprite * 4] + 1;
+        for (unsigned y = top; y < top + sprite_height && y < NES_HEIGHT; ++y) {
+            SpriteLine &line = sprite_lines[y];
+            if (line.count < 8) {
+                line.sprites[line.count++] = sprite;
+            } else {
+                line.overflow = true;
+            }
+        }
+    }
+
+    uint8_t next = NES_HEIGHT;
+    for (unsigned y = NES_HEIGHT; y-- > 0;) {
+        if (sprite_lines[y].overflow) next = y;
+        overflow_lines[y] = next;
+    }
+}
+
+static void decode_tile(const uint8_t *pattern, Tile &tile) {
+    for (uint8_t row = 0; row < TILE_HEIGHT; ++row) {
+        const uint8_t low = pattern[row];
+        const uint8_t high = pattern[row + 8];
+        for (uint8_t px = 0; px < TILE_WIDTH; ++px) {
+            const uint8_t bit = 7 - px;
+            tile.flipped[row][7 - px] = tile.pixels[row][px] = (high >> bit & 1) << 1 | low >> bit & 1;
+        }
+    }
+}
+
+const Tile *PPU::tiles() {
+    if (!chr_rom) {
+        return tile_cache;
+    }
+
+    for (unsigned slot = 0; slot < 8; ++slot) {
+        if (tile_source[slot] == chr[slot]) continue;
+        tile_source[slot] = chr[slot];
+        for (uint16_t tile = 0; tile < 64; ++tile) {
+            decode_tile(&chr[slot][tile * 16], tile_cache[slot * 64 + tile]);
+            tile_dirty[slot * 64 + tile] = 0;
+        }
+    }
+
+    if (tiles_dirty) {
+        for (uint16_t tile = 0; tile < 512; ++tile) {
+            if (tile_dirty[tile]) decode_tile(&chr[tile / 64][tile % 64 * 16], tile_cache[tile]);
+        }
+        memset(tile_dirty, 0, sizeof(tile_dirty));
+        tiles_dirty = false;
+    }
+    return tile_cache;
+}
+
+bool PPU::quiet_read(const uint16_t address) const {
+    switch (address & 7) {
+        case PPU_STATUS:
+            return !(status & BIT_7) && !w;
+        case PPU_DATA:
+            return false;
+        default:
+            return true;
+    }
+}
+
+}
@@ -1,37 +1,188 @@
 #pragma once
+#include <algorithm>
+
 #include "nes.h"
 
 #define TILE_WIDTH 8
 #define TILE_HEIGHT 8
 
-typedef struct {
-    uint8_t status;
-    uint16_t address;
+namespace dendy {
+
+// PPU::mirroring, how the 2K of VRAM make up the 4 nametables
+enum {
+    MIRROR_HORIZONTAL,
+    MIRROR_VERTICAL,
+    MIRROR_SINGLE_LOW, // All 4 are the first 1K, or the second
+    MIRROR_SINGLE_HIGH,
+};
+
+// One 8x8 pattern expanded to a 2-bit colour per byte, with a mirrored copy for horizontally flipped sprites
+struct Tile {
+    uint8_t pixels[TILE_HEIGHT][TILE_WIDTH];
+    uint8_t flipped[TILE_HEIGHT][TILE_WIDTH];
+};
 
-    uint8_t nmi_enabled;
-    uint8_t * chr_rom;
-    uint8_t * nametable;
-    uint8_t * sprites;
-    uint8_t * background;
+// Sprites the PPU evaluates for a visible line: the first 8 in OAM order, more than that sets the overflow flag
+struct SpriteLine {
+    uint8_t count;
+    bool overflow;
+    uint8_t sprites[8]; // OAM indexes
+};
+
+// What rendering a visible line depends on besides memory, as it stands when the line starts. Console keeps one
+// per line of the frame and renders from those.
+struct ScanlineState {
+    uint16_t v; // Scroll position, see PPU::v
+    uint8_t fine_x;
+    uint8_t background_enabled;
+    uint8_t sprites_enabled;
+    uint8_t background_left;
+    uint8_t sprites_left;
+    uint8_t sprite_height;
+    uint16_t background_tiles;
+    uint16_t sprite_tiles;
+};
 
+// PPU memory as drawing lines needs it, copied off the emulated PPU for one drawing elsewhere (RenderPipeline)
+struct PPUMemory {
+    uint8_t VRAM[2048]; // Nametables, indexed through PPU::nametable()
+    uint8_t OAM[256];
+    uint8_t CHRRAM[8192]; // Only copied while chr_rom is nullptr
+    const uint8_t *chr_rom; // CHR-ROM, nullptr for CHRRAM
+    uint32_t chr[8]; // Pattern table banks as offsets into chr_rom or CHRRAM
     uint8_t sprite_height;
-    uint8_t address_step;
+    uint8_t mirroring;
+};
+
+struct PPU {
+    uint8_t status = 0;
+
+    // Loopy's scroll registers, shared by $2005 and $2006:
+    // yyy NN YYYYY XXXXX
+    // ||| || ||||| +++++-- coarse X scroll
+    // ||| || +++++-------- coarse Y scroll
+    // ||| ++-------------- nametable select
+    // +++----------------- fine Y scroll
+    uint16_t v = 0; // Current VRAM address, also the scroll position while rendering
+    uint16_t t = 0; // Temporary address, the top left corner on screen
+    uint8_t x = 0; // Fine X scroll
+    uint8_t w = 0; // First or second write toggle
+
+    uint8_t nmi_enabled = 0;
+
+    // Pattern memory, CHR-ROM or CHRRAM on boards that have no ROM, and the 1K banks of it that make up the
+    // two pattern tables, as the mapper set them with map()
+    const uint8_t *chr_rom = nullptr;
+    const uint8_t *chr[8] = {};
+
+    // First tile of the pattern table in use, 0 or 256, indexes tiles()
+    uint16_t sprite_tiles = 0;
+    uint16_t background_tiles = 0;
+
+    uint8_t sprite_height = 8;
+    uint8_t address_step = 1;
 
     // |||| ||+-- 1: Show background in leftmost 8 pixels of screen, 0: Hide
     // |||| |+--- 1: Show sprites in leftmost 8 pixels of screen, 0: Hide
-    uint8_t background_enabled;
-    uint8_t sprites_enabled;
+    uint8_t background_left = 0;
+    uint8_t sprites_left = 0;
+    uint8_t background_enabled = 0;
+    uint8_t sprites_enabled = 0;
+    uint8_t mask = 0; // Last PPU_MASK write, its grayscale and emphasis bits colour whole frames (ScreenConverter)
 
-    uint16_t scroll_x;
-    uint16_t scroll_y;
+    uint8_t mirroring = MIRROR_HORIZONTAL;
 
-    /* 1 - vertical ; 0 - horizontal */
-    uint8_t mirroring;
+    // VRAM offset of a nametable address ($2000-$2FFF) after mirroring
+    uint16_t nametable(const uint16_t address) const {
+        return NAMETABLES[mirroring][address >> 10 & 3] | (address & 0x3FF);
+    }
+
+    // Pattern table banks, into chr_rom, and mirroring as the cartridge sets them. Changes count in memory_writes.
+    void map(const uint8_t *chr_rom, const uint8_t *const chr[8], uint8_t mirroring);
+
+    // True if map() would change nothing
+    bool mapped(const uint8_t *const chr[8], const uint8_t mirroring) const {
+        return this->mirroring == mirroring && std::equal(chr, chr + 8, this->chr);
+    }
+
+    uint8_t VRAM[16384] = { 0 };
+    uint8_t OAM[256] = { 0 };
+    uint8_t PALETTE[64] = { 0 };
+
+    uint8_t CHRRAM[8192] = { 0 };
+
+    uint8_t read(uint16_t address);
+
+    // True if read() would leave the PPU as it is: polling $2002 once vblank and the w toggle are clear
+    bool quiet_read(uint16_t address) const;
+
+    void write(uint16_t address, uint8_t data);
+
+    bool rendering() const { return background_enabled || sprites_enabled; }
+
+    ScanlineState scanline_state() const;
+
+    // What the PPU does to v while rendering: moving down a line at dot 256, coarse X back to the left at
+    // dot 257 of every line, and all of t at the pre-render line
+    void increment_y();
+    void copy_x() { v = (v & ~0x041F) | (t & 0x041F); }
+    void copy_xy() { v = t; }
+
+    // Copies a page to OAM ($4014 DMA)
+    void oam_dma(const uint8_t *page);
+
+    // Counts changes to what PPUMemory holds: writes to VRAM, OAM and CHR-RAM, the sprite height, banks and
+    // mirroring
+    uint32_t memory_writes = 0;
+
+    void save(PPUMemory &memory) const;
+
+    // Takes over saved memory, decoding again only the tiles and sprite lists that changed
+    void load(const PPUMemory &memory);
+
+    // Sprites on a visible line. The lists for the whole frame are built at once, again only after OAM or the
+    // sprite height changes.
+    const SpriteLine &sprite_line(unsigned scanline);
+
+    // First visible line from scanline on with more sprites than 8, NES_HEIGHT if there is none
+    unsigned overflow_line(unsigned scanline);
+
+    // Both pattern tables decoded, 512 tiles. Brings the cache up to date first: tiles written through $2007
+    // since the last call are decoded again, and the 64 of every bank that has been switched.
+    const Tile *tiles();
+
+private:
+    // VRAM offsets of the 4 nametables for each mirroring
+    static constexpr uint16_t NAMETABLES[4][4] = {
+        { 0, 0, 0x400, 0x400 },
+        { 0, 0x400, 0, 0x400 },
+        { 0, 0, 0, 0 },
+        { 0x400, 0x400, 0x400, 0x400 },
+    };
+
+    uint8_t read_buffer = 0;
+    uint8_t oam_address = 0;
+
+    SpriteLine sprite_lines[NES_HEIGHT] = {};
+    uint8_t overflow_lines[NES_HEIGHT] = {}; // overflow_line() of each line
+    bool sprites_dirty = true;
+
+    void update_sprite_lines();
+
+    Tile tile_cache[512] = {};
+    uint8_t tile_dirty[512] = { 0 };
+    bool tiles_dirty = false;
+    const uint8_t *tile_source[8] = {}; // Banks the cache was decoded from
+
+    void increment_address();
 
-} PPU;
+    // Marks the tiles of every bank CHRRAM is seen through at offset for decoding again, and the slots the
+    // cache still holds it for after switching away
+    void chr_ram_written(uint16_t offset);
 
-extern PPU ppu;
+    void vram_write(uint16_t address, uint8_t value);
 
-uint8_t ppu_read(uint16_t address);
+    uint8_t vram_read(uint16_t address);
+};
 
-void ppu_write(uint16_t address, uint8_t data);
+}
@@ -0,0 +1,23 @@
+#include "rate_control.h"
+
+#include <algorithm>
+
+namespace dendy {
+
+RateControl::RateControl(const AudioRing &ring, const unsigned rate, const unsigned latency_ms)
+    : ring(ring), rate(rate) {
+    // A frame has to fit on top of the target
+    target = std::clamp<size_t>(static_cast<size_t>(rate) * latency_ms / 1000, 1, ring.capacity() - rate / 50);
+}
+
+double RateControl::pace() {
+    ring.drain(target);
+
+    // Proportional to how far off the target the ring is
+    const double fill = static_cast<double>(ring.size());
+    current = std::clamp(1 + MAX_SKEW * (static_cast<double>(target) - fill) / static_cast<double>(target),
+                         1 - MAX_SKEW, 1 + MAX_SKEW);
+    return current;
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+
+#include "audio_ring.h"
+
+namespace dendy {
+
+// Dynamic rate control: runs the emulation off the audio device's clock instead of the wall clock, with a bounded
+// latency and without dropping or repeating frames. Frames are held back while the ring has more than the target
+// latency in it, which paces them at the device's rate. Below that, the fill level steers the resampling ratio by
+// up to MAX_SKEW, so the ring settles at the target instead of slowly draining because the console's 60.1 Hz and
+// the device's crystal never quite agree. A skew that small is far below a pitch change anyone hears.
+class RateControl {
+public:
+    static constexpr double MAX_SKEW = 0.005;
+
+    RateControl(const AudioRing &ring, unsigned rate, unsigned latency_ms);
+
+    // After a frame's samples went into the ring: waits while more than the target is in it, then returns the
+    // resampling ratio to make the next frame's samples at
+    double pace();
+
+    // Audio buffered in the ring right now, in ms, not counting what the device holds itself
+    double latency() const { return ring.size() * 1000.0 / rate; }
+
+    double ratio() const { return current; }
+
+private:
+    const AudioRing &ring;
+    unsigned rate;
+    size_t target; // In samples
+    double current = 1;
+};
+
+}
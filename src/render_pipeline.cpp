@@ -0,0 +1,62 @@
+#include "render_pipeline.h"
+
+#include <cstring>
+
+namespace dendy {
+
+RenderPipeline::RenderPipeline(const unsigned bands) : renderer(bands) {
+    worker = std::thread(&RenderPipeline::run, this);
+}
+
+RenderPipeline::~RenderPipeline() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void RenderPipeline::submit(const PPU &ppu, uint8_t *screen, uint8_t *palette, uint8_t &mask) {
+    RecordedFrame &frame = frames[recording];
+    memcpy(frame.palette, ppu.PALETTE, sizeof(frame.palette));
+    frame.mask = ppu.mask;
+
+    flush(screen, palette, mask);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pending = &frame;
+    }
+    wake.notify_one();
+
+    recording ^= 1;
+    restart();
+}
+
+void RenderPipeline::flush(uint8_t *screen, uint8_t *palette, uint8_t &mask) {
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [this] { return !pending; });
+    memcpy(screen, this->screen, sizeof(this->screen));
+    memcpy(palette, this->palette, sizeof(this->palette));
+    mask = this->mask;
+}
+
+void RenderPipeline::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        wake.wait(guard, [this] { return pending || stopping; });
+        if (stopping) return;
+
+        const RecordedFrame &frame = *pending;
+        guard.unlock();
+        renderer.draw(frame, screen);
+        memcpy(palette, frame.palette, sizeof(palette));
+        mask = frame.mask;
+        guard.lock();
+
+        pending = nullptr;
+        done.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "band_renderer.h"
+#include "nes.h"
+#include "ppu.h"
+
+namespace dendy {
+
+// Draws frames on a worker thread while the CPU thread runs the next one, see Console::use_pipeline(). The CPU
+// thread records a frame (RecordedFrame) and hands it over at vblank, it is drawn by the next one, so the screen
+// is one frame behind. The worker draws with a BandRenderer, on more threads if asked to.
+class RenderPipeline {
+public:
+    explicit RenderPipeline(unsigned bands = 1);
+    ~RenderPipeline();
+
+    RenderPipeline(const RenderPipeline &) = delete;
+    RenderPipeline &operator=(const RenderPipeline &) = delete;
+
+    // A line of the frame, as it would be drawn now
+    void record(const unsigned scanline, const ScanlineState &state, const PPU &ppu) {
+        frames[recording].record(scanline, state, ppu);
+    }
+
+    // Hands the frame recorded over to the worker, once it has drawn the one before into screen, palette and mask
+    void submit(const PPU &ppu, uint8_t *screen, uint8_t *palette, uint8_t &mask);
+
+    // Waits for the frame handed over last and copies it out, for when the pipeline stops or has to catch up
+    void flush(uint8_t *screen, uint8_t *palette, uint8_t &mask);
+
+    // Drops the lines recorded so far, on reset
+    void restart() { frames[recording].clear(); }
+
+    // Frame handed over last, it stays as it is until the next submit()
+    const RecordedFrame &submitted() const { return frames[recording ^ 1]; }
+
+private:
+    void run();
+
+    // CPU thread side
+    RecordedFrame frames[2];
+    unsigned recording = 0;
+
+    // Worker side, handed out by submit() and flush() only while the worker is idle
+    BandRenderer renderer;
+    uint8_t screen[NES_WIDTH * NES_HEIGHT] = { 0 };
+    uint8_t palette[32] = { 0 };
+    uint8_t mask = 0;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const RecordedFrame *pending = nullptr; // Frame handed over and not drawn yet
+    bool stopping = false;
+    std::thread worker;
+};
+
+}
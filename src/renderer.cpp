@@ -0,0 +1,132 @@
+// https://emudev.de/nes-emulator/palettes-attribute-tables-and-sprites/
+// https://austinmorlan.com/posts/nes_rendering_overview/
+// https://www.copetti.org/writings/consoles/nes/#graphics
+#include "renderer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace dendy {
+
+void Renderer::render(PPU &ppu, const unsigned scanline, const ScanlineState &state, uint8_t *screen) {
+    render_background(ppu, state);
+    render_sprites(ppu, scanline, state);
+    compose(screen);
+}
+
+int Renderer::sprite0_hit(PPU &ppu, const unsigned scanline, const ScanlineState &state) const {
+    if (!state.background_enabled || !state.sprites_enabled) return -1;
+
+    const unsigned top = ppu.OAM[0] + 1;
+    const unsigned height = state.sprite_height;
+    if (scanline < top || scanline >= top + height) return -1;
+
+    const uint8_t attributes = ppu.OAM[2];
+    unsigned row = attributes & BIT_7 ? top + height - 1 - scanline : scanline - top;
+    unsigned tile = state.sprite_tiles + ppu.OAM[1];
+    if (height == 16) {
+        tile = (ppu.OAM[1] & 1) * 256 + (ppu.OAM[1] & 0xFE) + row / 8;
+        row %= 8;
+    }
+    const Tile &pattern = ppu.tiles()[tile];
+    const uint8_t *pixels = attributes & BIT_6 ? pattern.flipped[row] : pattern.pixels[row];
+
+    // Nothing hits in the left 8 pixels while either layer is clipped there
+    const unsigned left = state.background_left && state.sprites_left ? 0 : 8;
+    for (unsigned px = 0; px < 8; ++px) {
+        const unsigned x = ppu.OAM[3] + px;
+        if (x >= 255) break; // Never hits at x=255
+        if (x >= left && pixels[px] && line.background[x] & 3) return x;
+    }
+    return -1;
+}
+
+void Renderer::render_background(const PPU &ppu, const ScanlineState &state, const unsigned first, const unsigned count) {
+    if (state.background_enabled) {
+        const uint16_t table = state.background_tiles * 16 | state.v >> 12; // Fine Y
+
+        // Gather the pattern bytes and palettes of the 33 tiles fine X scrolls across, from v on, then expand
+        // them all at once (SIMD where available)
+        TileRow tile_row = {};
+        const unsigned coarse_x = (state.v & 0x001F) + first;
+        uint16_t v = (state.v & ~0x001F | coarse_x & 0x001F) ^ (coarse_x & 32) << 5;
+        const unsigned last = std::min(first + count, TileRow::TILES);
+        for (unsigned tile = first; tile < last; ++tile) {
+            const uint16_t address = table + 16 * ppu.VRAM[ppu.nametable(0x2000 | v & 0x0FFF)];
+            const uint8_t *pattern = &ppu.chr[address >> 10][address & 0x3FF];
+            tile_row.low[tile] = pattern[0];
+            tile_row.high[tile] = pattern[8];
+
+            // An attribute byte covers 4x4 tiles, two bits for each 2x2 quadrant
+            const uint8_t attributes = ppu.VRAM[ppu.nametable(0x23C0 | v & 0x0C00 | v >> 4 & 0x38 | v >> 2 & 0x07)];
+            const uint8_t shift = v >> 4 & 4 | v & 2;
+            tile_row.palette[tile] = (attributes >> shift & 0x03) << 2;
+
+            // Coarse X wraps into the horizontally adjacent nametable
+            v = (v & 0x001F) == 31 ? (v & ~0x001F) ^ 0x0400 : v + 1;
+        }
+
+        alignas(16) uint8_t pixels[TileRow::PADDED * 8];
+        expand_tiles()(tile_row, pixels);
+        memcpy(line.background, &pixels[state.fine_x], NES_WIDTH);
+        if (!state.background_left) memset(line.background, 0, 8);
+    } else {
+        memset(line.background, 0, sizeof(line.background));
+    }
+}
+
+void Renderer::render_sprites(PPU &ppu, const unsigned scanline, const ScanlineState &state) {
+    const uint8_t sprite_height = state.sprite_height;
+    const uint8_t sprite_index_mask = sprite_height == 16 ? 0xFE : 0xFF;
+
+    memset(line.sprites, 0, sizeof(line.sprites));
+    memset(line.behind, 0, sizeof(line.behind));
+
+    if (state.sprites_enabled) {
+        const SpriteLine &evaluated = ppu.sprite_line(scanline);
+        const Tile *patterns = ppu.tiles();
+
+        // In OAM order, the first opaque pixel at an X wins whatever its priority (a background sprite there
+        // hides the sprites after it too)
+        for (unsigned i = 0; i < evaluated.count; ++i) {
+            const uint16_t sprite = evaluated.sprites[i] * 4;
+            const uint8_t sprite_y = ppu.OAM[sprite] + 1; // Y-coordinate
+
+            const uint8_t sprite_index = ppu.OAM[sprite + 1] & sprite_index_mask; // Tile index
+            const uint8_t attributes = ppu.OAM[sprite + 2]; // Attributes
+            const uint8_t sprite_x = ppu.OAM[sprite + 3]; // X-coordinate
+
+            // Determine the sprite palette and flipping
+            const uint8_t palette_index = attributes & 3; // Bits 0-1
+            const uint8_t priority = attributes & BIT_5;
+            const uint8_t flip_horizontally = attributes & BIT_6;
+            const uint8_t flip_vertically = attributes & BIT_7;
+
+            const uint8_t row = flip_vertically ? sprite_height - 1 - (scanline - sprite_y) : scanline - sprite_y;
+
+            // 8x16 sprites take their pattern table from bit 0 of the index, the bottom half is the next tile
+            const uint16_t tile = sprite_height == 16 ? (ppu.OAM[sprite + 1] & 1) * 256 + sprite_index + row / 8
+                                                      : state.sprite_tiles + sprite_index;
+            const Tile &pattern = patterns[tile];
+            const uint8_t *pixels = flip_horizontally ? pattern.flipped[row % 8] : pattern.pixels[row % 8];
+
+            // Sprite palettes are $10-$1F
+            const uint8_t colour = 0x10 | palette_index << 2;
+            const uint8_t behind = priority ? 0xFF : 0;
+            uint8_t *sprites = &line.sprites[sprite_x];
+            uint8_t *behinds = &line.behind[sprite_x];
+
+            // Sprites near the right edge are cut off rather than wrap to the next line
+            const unsigned width = std::min(8, NES_WIDTH - sprite_x);
+            for (unsigned px = 0; px < width; ++px) {
+                const uint8_t take = -((pixels[px] != 0) & (sprites[px] == 0));
+                sprites[px] |= (colour | pixels[px]) & take;
+                behinds[px] |= behind & take;
+            }
+        }
+
+        if (!state.sprites_left) memset(line.sprites, 0, 8);
+    }
+}
+
+}
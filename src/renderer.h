@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+#include "compositor.h"
+#include "ppu.h"
+#include "tile_row.h"
+
+namespace dendy {
+
+// Draws visible lines from their ScanlineState and the PPU's memory into a screen of palette indexes. It holds
+// the line buffers, so every thread drawing needs its own. PPU::tiles() and PPU::sprite_line() bring their
+// caches up to date on first use; once they have, renderers on several threads can share the PPU.
+class Renderer {
+public:
+    // Background and sprites of a line, composed into NES_WIDTH pixels of screen
+    void render(PPU &ppu, unsigned scanline, const ScanlineState &state, uint8_t *screen);
+
+    // Background into the line buffers, or only count tiles of it from the first one on (the rest stays transparent)
+    void render_background(const PPU &ppu, const ScanlineState &state, unsigned first = 0,
+                           unsigned count = TileRow::TILES);
+
+    void render_sprites(PPU &ppu, unsigned scanline, const ScanlineState &state);
+
+    // Merges the line buffers into NES_WIDTH pixels of screen
+    void compose(uint8_t *screen) const { compose_line(line, screen); }
+
+    // X of the first opaque sprite 0 pixel over opaque background on the line in the buffers, -1 if none
+    int sprite0_hit(PPU &ppu, unsigned scanline, const ScanlineState &state) const;
+
+private:
+    LineBuffers line = {};
+};
+
+}
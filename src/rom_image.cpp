@@ -0,0 +1,149 @@
+#include "rom_image.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "nes.h"
+
+namespace dendy {
+
+struct ines_header_t {
+    char magic[4]; // iNES magic string "NES\x1A"
+    uint8_t prg_rom_size; // PRG ROM size in 16 KB units
+    uint8_t chr_rom_size; // CHR ROM size in 8 KB units
+    uint8_t flags6; // Flags 6: Mapper, mirroring, battery, etc.
+    uint8_t flags7; // Flags 7: Mapper, VS/PlayChoice, NES 2.0 indicator
+    uint8_t prg_ram_size; // PRG RAM size in 8 KB units (0 = default 8 KB)
+    uint8_t flags9; // Flags 9: TV system (NTSC/PAL)
+    uint8_t flags10; // Flags 10: Miscellaneous
+    uint8_t padding[5]; // Padding (should be zero)
+};
+
+// Instructions are only decoded within this range, so any 8K bank mapping keeps them valid
+#define PRG_DECODE_BANK 0x2000
+
+static std::mutex cache_lock;
+static std::unordered_map<uint64_t, std::weak_ptr<const RomImage>> cache;
+
+// FNV-1a, only used to find identical images
+static uint64_t content_hash(const uint8_t *data, const size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ data[i]) * 1099511628211ull;
+    return hash;
+}
+
+RomImage::~RomImage() {
+#ifndef _WIN32
+    if (mapped) munmap(const_cast<uint8_t *>(data), size);
+#endif
+}
+
+bool RomImage::map(const char *pathname) {
+#ifndef _WIN32
+    const int fd = open(pathname, O_RDONLY);
+    if (fd >= 0) {
+        struct stat st = {};
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *address = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                data = static_cast<const uint8_t *>(address);
+                size = st.st_size;
+                mapped = true;
+            }
+        }
+        close(fd);
+        if (mapped) return true;
+    }
+#endif
+
+    FILE *file = fopen(pathname, "rb");
+    if (!file) {
+        fprintf(stderr, "Can't open %s\n", pathname);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    buffer.resize(ftell(file));
+    fseek(file, 0, SEEK_SET);
+    buffer.resize(fread(buffer.data(), sizeof(uint8_t), buffer.size(), file));
+    fclose(file);
+
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+}
+
+bool RomImage::parse_ines_header(const char *pathname) {
+    ines_header_t INES;
+    if (size < sizeof(ines_header_t) || memcmp(data, "NES\x1A", 4) != 0) {
+        fprintf(stderr, "Invalid iNES file %s!\n", pathname);
+        return false;
+    }
+    memcpy(&INES, data, sizeof(ines_header_t));
+
+    const size_t trainer_size = INES.flags6 & 0x04 ? 512 : 0;
+    prg_size = INES.prg_rom_size * 16 << 10;
+    chr_size = INES.chr_rom_size * 8 << 10;
+
+    if (!prg_size || sizeof(ines_header_t) + trainer_size + prg_size + chr_size > size) {
+        fprintf(stderr, "Truncated iNES file %s!\n", pathname);
+        return false;
+    }
+
+    prg = data + sizeof(ines_header_t) + trainer_size;
+    chr = chr_size ? prg + prg_size : nullptr;
+    mirroring = INES.flags6 & 0x01;
+    battery = INES.flags6 & 0x02 ? 1 : 0;
+    mapper = INES.flags7 & 0xF0 | INES.flags6 >> 4;
+
+    decoded.reset(new Decoded6502[prg_size]);
+    for (size_t bank = 0; bank < prg_size; bank += PRG_DECODE_BANK) {
+        Decode6502(&decoded[bank], prg + bank, PRG_DECODE_BANK);
+    }
+
+    debug_log("iNES Header Info:\n");
+    debug_log("PRG ROM Size: %d KB\n", INES.prg_rom_size * 16);
+    debug_log("CHR ROM Size: %d KB\n", INES.chr_rom_size * 8);
+    debug_log("Mapper: %d\n", mapper);
+    debug_log("Mirroring: %s\n", (INES.flags6 & 0x01) ? "Vertical" : "Horizontal");
+    debug_log("Battery-backed Save: %s\n", (INES.flags6 & 0x02) ? "Yes" : "No");
+    debug_log("Trainer Present: %s\n", (INES.flags6 & 0x04) ? "Yes" : "No");
+    debug_log("Four-screen Mode: %s\n", (INES.flags6 & 0x08) ? "Yes" : "No");
+    debug_log("TV System: %s\n", (INES.flags9 & 0x01) ? "PAL" : "NTSC");
+    debug_log("PRG RAM Size: %d KB\n", INES.prg_ram_size ? INES.prg_ram_size * 8 : 8);
+
+    debug_log("\n\n\n");
+    return true;
+}
+
+std::shared_ptr<const RomImage> RomImage::load(const char *pathname) {
+    std::shared_ptr<RomImage> image(new RomImage());
+    if (!image->map(pathname))
+        return nullptr;
+
+    image->hash = content_hash(image->data, image->size);
+
+    std::lock_guard<std::mutex> guard(cache_lock);
+
+    if (const auto cached = cache.find(image->hash); cached != cache.end()) {
+        std::shared_ptr<const RomImage> existing = cached->second.lock();
+        if (existing && existing->size == image->size && !memcmp(existing->data, image->data, image->size))
+            return existing;
+    }
+
+    if (!image->parse_ines_header(pathname))
+        return nullptr;
+
+    std::erase_if(cache, [](const auto &entry) { return entry.second.expired(); });
+    cache[image->hash] = image;
+    return image;
+}
+
+}
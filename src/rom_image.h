@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "m6502/M6502.h"
+
+namespace dendy {
+
+// Read-only iNES image. Images are cached by content hash, so every console running the same game
+// shares one mapping of its PRG/CHR data; consoles keep only mutable state (CHR-RAM, PRG-RAM, banks).
+class RomImage {
+public:
+    ~RomImage();
+
+    RomImage(const RomImage &) = delete;
+    RomImage &operator=(const RomImage &) = delete;
+
+    // Returns the shared image with the file's contents, mapping it on first use; nullptr on error
+    static std::shared_ptr<const RomImage> load(const char *pathname);
+
+    const uint8_t *prg = nullptr;
+    size_t prg_size = 0;
+    const uint8_t *chr = nullptr; // nullptr for CHR-RAM boards
+    size_t chr_size = 0;
+
+    // PRG pre-decoded for Exec6502 in 8K banks, the smallest unit a mapper switches, indexed like prg
+    std::unique_ptr<Decoded6502[]> decoded;
+
+    uint8_t mapper = 0;
+    /* 1 - vertical ; 0 - horizontal */
+    uint8_t mirroring = 0;
+    uint8_t battery = 0;
+
+    uint64_t hash = 0;
+
+private:
+    RomImage() = default;
+
+    bool map(const char *pathname);
+
+    bool parse_ines_header(const char *pathname);
+
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::vector<uint8_t> buffer; // Fallback when the file can't be mapped
+};
+
+}
@@ -0,0 +1,50 @@
+#include "scheduler.h"
+
+namespace dendy {
+
+Scheduler::event Scheduler::add(handler callback) {
+    events.push_back({ NEVER, std::move(callback) });
+    return events.size() - 1;
+}
+
+void Scheduler::schedule(const event id, const uint64_t time) {
+    events[id].time = time;
+    update_next();
+}
+
+void Scheduler::cancel(const event id) {
+    events[id].time = NEVER;
+    update_next();
+}
+
+void Scheduler::cancel_all() {
+    for (Event &event : events) event.time = NEVER;
+    next_time = NEVER;
+}
+
+// A handful of events, a linear scan beats keeping a heap in order
+void Scheduler::update_next() {
+    next_time = NEVER;
+    for (event id = 0; id < events.size(); ++id) {
+        if (events[id].time < next_time) {
+            next_time = events[id].time;
+            next_event = id;
+        }
+    }
+}
+
+bool Scheduler::run(const uint64_t now) {
+    bool fired = false;
+    while (next_time <= now) {
+        Event &event = events[next_event];
+        const uint64_t time = event.time;
+        event.time = NEVER;
+        update_next();
+
+        event.callback(time);
+        fired = true;
+    }
+    return fired;
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace dendy {
+
+// Cycle-timestamped events on the CPU clock (M6502::Clock). The console runs the CPU up to the earliest
+// deadline and then fires whatever is due, so PPU timing, mapper IRQs or an APU frame counter don't have to
+// be polled at fixed intervals. Handlers get the time they were scheduled for rather than the CPU's overshoot
+// past it, which lets periodic events reschedule themselves without drifting.
+class Scheduler {
+public:
+    using event = unsigned;
+    using handler = std::function<void(uint64_t time)>;
+
+    static constexpr uint64_t NEVER = UINT64_MAX;
+
+    // Registers an event, unscheduled until schedule()
+    event add(handler callback);
+
+    // An event is pending at most once, scheduling it again moves it
+    void schedule(event id, uint64_t time);
+
+    void cancel(event id);
+
+    void cancel_all();
+
+    bool pending(const event id) const { return events[id].time != NEVER; }
+
+    // Earliest deadline, NEVER if nothing is pending
+    uint64_t next() const { return next_time; }
+
+    // Fires the events due at or before now in time order, added order for ties, including those the handlers
+    // schedule within that range. Returns true if any fired.
+    bool run(uint64_t now);
+
+private:
+    struct Event {
+        uint64_t time = NEVER;
+        handler callback;
+    };
+
+    void update_next();
+
+    std::vector<Event> events;
+    uint64_t next_time = NEVER;
+    event next_event = 0;
+};
+
+}
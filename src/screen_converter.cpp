@@ -0,0 +1,261 @@
+#include "screen_converter.h"
+
+#include <array>
+#include <cstring>
+#include <iterator>
+
+// SSSE3 and AVX2 are checked for at run time, their byte shuffles look up 16 colours at once
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SCREEN_CONVERTER_X86
+#endif
+
+namespace dendy {
+
+size_t frame_size(const PixelFormat format) {
+    switch (format) {
+        case PixelFormat::ARGB8888:
+            return NES_WIDTH * NES_HEIGHT * 4;
+        case PixelFormat::RGB565:
+            return NES_WIDTH * NES_HEIGHT * 2;
+        case PixelFormat::YUV420:
+            return NES_WIDTH * NES_HEIGHT * 3 / 2;
+    }
+    return 0;
+}
+
+static void argb_scalar(const ScreenColours &colours, const uint8_t *screen, void *pixels) {
+    uint8_t *out = static_cast<uint8_t *>(pixels);
+    for (unsigned i = 0; i < NES_WIDTH * NES_HEIGHT; ++i) {
+        const uint8_t index = screen[i] & 31;
+        for (unsigned byte = 0; byte < 4; ++byte) *out++ = colours.argb[byte][index];
+    }
+}
+
+static void rgb565_scalar(const ScreenColours &colours, const uint8_t *screen, void *pixels) {
+    uint8_t *out = static_cast<uint8_t *>(pixels);
+    for (unsigned i = 0; i < NES_WIDTH * NES_HEIGHT; ++i) {
+        const uint8_t index = screen[i] & 31;
+        *out++ = colours.rgb565[0][index];
+        *out++ = colours.rgb565[1][index];
+    }
+}
+
+// Chroma of a 2x2 block: rows averaged first, then the two columns, rounding up each time
+static inline uint8_t average(const uint8_t a, const uint8_t b) {
+    return (a + b + 1) >> 1;
+}
+
+static void yuv420_scalar(const ScreenColours &colours, const uint8_t *screen, void *pixels) {
+    uint8_t *y_plane = static_cast<uint8_t *>(pixels);
+    uint8_t *u_plane = y_plane + NES_WIDTH * NES_HEIGHT;
+    uint8_t *v_plane = u_plane + NES_WIDTH * NES_HEIGHT / 4;
+
+    for (unsigned i = 0; i < NES_WIDTH * NES_HEIGHT; ++i) y_plane[i] = colours.yuv[0][screen[i] & 31];
+
+    for (unsigned y = 0; y < NES_HEIGHT; y += 2) {
+        const uint8_t *top = &screen[y * NES_WIDTH];
+        const uint8_t *bottom = top + NES_WIDTH;
+        for (unsigned x = 0; x < NES_WIDTH; x += 2) {
+            for (unsigned plane = 1; plane < 3; ++plane) {
+                const uint8_t *table = colours.yuv[plane];
+                const uint8_t left = average(table[top[x] & 31], table[bottom[x] & 31]);
+                const uint8_t right = average(table[top[x + 1] & 31], table[bottom[x + 1] & 31]);
+                (plane == 1 ? u_plane : v_plane)[y / 2 * NES_WIDTH / 2 + x / 2] = average(left, right);
+            }
+        }
+    }
+}
+
+static bool always() {
+    return true;
+}
+
+#ifdef SCREEN_CONVERTER_X86
+// Colours of 16 indexes from a 32 byte table: a shuffle of each half by the low nibble, picked by bit 4
+__attribute__((target("ssse3"))) static inline __m128i lookup_ssse3(const uint8_t *table, const __m128i index) {
+    const __m128i nibble = _mm_and_si128(index, _mm_set1_epi8(0x0F));
+    const __m128i high = _mm_cmpeq_epi8(_mm_and_si128(index, _mm_set1_epi8(0x10)), _mm_set1_epi8(0x10));
+    const __m128i low_half = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i *>(table)), nibble);
+    const __m128i high_half = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i *>(table + 16)), nibble);
+    return _mm_or_si128(_mm_andnot_si128(high, low_half), _mm_and_si128(high, high_half));
+}
+
+__attribute__((target("ssse3"))) static void argb_ssse3(const ScreenColours &colours, const uint8_t *screen,
+                                                       void *pixels) {
+    __m128i *out = static_cast<__m128i *>(pixels);
+    for (unsigned i = 0; i < NES_WIDTH * NES_HEIGHT; i += 16) {
+        const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&screen[i]));
+        const __m128i b = lookup_ssse3(colours.argb[0], index);
+        const __m128i g = lookup_ssse3(colours.argb[1], index);
+        const __m128i r = lookup_ssse3(colours.argb[2], index);
+        const __m128i a = lookup_ssse3(colours.argb[3], index);
+
+        // Interleave the planes back into pixels
+        const __m128i bg_low = _mm_unpacklo_epi8(b, g), bg_high = _mm_unpackhi_epi8(b, g);
+        const __m128i ra_low = _mm_unpacklo_epi8(r, a), ra_high = _mm_unpackhi_epi8(r, a);
+        _mm_storeu_si128(out++, _mm_unpacklo_epi16(bg_low, ra_low));
+        _mm_storeu_si128(out++, _mm_unpackhi_epi16(bg_low, ra_low));
+        _mm_storeu_si128(out++, _mm_unpacklo_epi16(bg_high, ra_high));
+        _mm_storeu_si128(out++, _mm_unpackhi_epi16(bg_high, ra_high));
+    }
+}
+
+__attribute__((target("ssse3"))) static void rgb565_ssse3(const ScreenColours &colours, const uint8_t *screen,
+                                                         void *pixels) {
+    __m128i *out = static_cast<__m128i *>(pixels);
+    for (unsigned i = 0; i < NES_WIDTH * NES_HEIGHT; i += 16) {
+        const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&screen[i]));
+        const __m128i low = lookup_ssse3(colours.rgb565[0], index);
+        const __m128i high = lookup_ssse3(colours.rgb565[1], index);
+        _mm_storeu_si128(out++, _mm_unpacklo_epi8(low, high));
+        _mm_storeu_si128(out++, _mm_unpackhi_epi8(low, high));
+    }
+}
+
+// 16 chroma bytes of 32 columns of a row pair, rounded as average() does
+__attribute__((target("ssse3"))) static inline __m128i chroma_ssse3(const uint8_t *table, const uint8_t *top,
+                                                                   const uint8_t *bottom) {
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    __m128i halves[2];
+    for (unsigned half = 0; half < 2; ++half) {
+        const __m128i upper = lookup_ssse3(table, _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + half * 16)));
+        const __m128i lower =
+                lookup_ssse3(table, _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + half * 16)));
+        const __m128i rows = _mm_avg_epu8(upper, lower);
+        halves[half] = _mm_avg_epu16(_mm_and_si128(rows, mask), _mm_srli_epi16(rows, 8));
+    }
+    return _mm_packus_epi16(halves[0], halves[1]);
+}
+
+__attribute__((target("ssse3"))) static void yuv420_ssse3(const ScreenColours &colours, const uint8_t *screen,
+                                                         void *pixels) {
+    uint8_t *y_plane = static_cast<uint8_t *>(pixels);
+    uint8_t *u_plane = y_plane + NES_WIDTH * NES_HEIGHT;
+    uint8_t *v_plane = u_plane + NES_WIDTH * NES_HEIGHT / 4;
+
+    for (unsigned i = 0; i < NES_WIDTH * NES_HEIGHT; i += 16) {
+        const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&screen[i]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&y_plane[i]), lookup_ssse3(colours.yuv[0], index));
+    }
+
+    for (unsigned y = 0; y < NES_HEIGHT; y += 2) {
+        const uint8_t *top = &screen[y * NES_WIDTH];
+        const uint8_t *bottom = top + NES_WIDTH;
+        const unsigned row = y / 2 * NES_WIDTH / 2;
+        for (unsigned x = 0; x < NES_WIDTH; x += 32) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(&u_plane[row + x / 2]),
+                             chroma_ssse3(colours.yuv[1], top + x, bottom + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(&v_plane[row + x / 2]),
+                             chroma_ssse3(colours.yuv[2], top + x, bottom + x));
+        }
+    }
+}
+
+// AVX2 shuffles within 128-bit lanes, so the tables are repeated in both and 32 indexes go at once
+__attribute__((target("avx2"))) static inline __m256i lookup_avx2(const uint8_t *table, const __m256i index) {
+    const __m256i nibble = _mm256_and_si256(index, _mm256_set1_epi8(0x0F));
+    const __m256i high = _mm256_cmpeq_epi8(_mm256_and_si256(index, _mm256_set1_epi8(0x10)), _mm256_set1_epi8(0x10));
+    const __m256i low_table = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(table)));
+    const __m256i high_table =
+            _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(table + 16)));
+    return _mm256_blendv_epi8(_mm256_shuffle_epi8(low_table, nibble), _mm256_shuffle_epi8(high_table, nibble), high);
+}
+
+__attribute__((target("avx2"))) static void argb_avx2(const ScreenColours &colours, const uint8_t *screen,
+                                                     void *pixels) {
+    __m256i *out = static_cast<__m256i *>(pixels);
+    for (unsigned i = 0; i < NES_WIDTH * NES_HEIGHT; i += 32) {
+        const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&screen[i]));
+        const __m256i b = lookup_avx2(colours.argb[0], index);
+        const __m256i g = lookup_avx2(colours.argb[1], index);
+        const __m256i r = lookup_avx2(colours.argb[2], index);
+        const __m256i a = lookup_avx2(colours.argb[3], index);
+
+        // Unpacks stay in their lane too: pixels 0-15 come out of the low lanes, 16-31 out of the high ones
+        const __m256i bg_low = _mm256_unpacklo_epi8(b, g), bg_high = _mm256_unpackhi_epi8(b, g);
+        const __m256i ra_low = _mm256_unpacklo_epi8(r, a), ra_high = _mm256_unpackhi_epi8(r, a);
+        const __m256i p0 = _mm256_unpacklo_epi16(bg_low, ra_low), p1 = _mm256_unpackhi_epi16(bg_low, ra_low);
+        const __m256i p2 = _mm256_unpacklo_epi16(bg_high, ra_high), p3 = _mm256_unpackhi_epi16(bg_high, ra_high);
+        _mm256_storeu_si256(out++, _mm256_permute2x128_si256(p0, p1, 0x20));
+        _mm256_storeu_si256(out++, _mm256_permute2x128_si256(p2, p3, 0x20));
+        _mm256_storeu_si256(out++, _mm256_permute2x128_si256(p0, p1, 0x31));
+        _mm256_storeu_si256(out++, _mm256_permute2x128_si256(p2, p3, 0x31));
+    }
+}
+
+static bool has_ssse3() {
+    return __builtin_cpu_supports("ssse3");
+}
+
+static bool has_avx2() {
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+const ScreenConversion screen_conversions[] = {
+    { "scalar", PixelFormat::ARGB8888, argb_scalar, always },
+    { "scalar", PixelFormat::RGB565, rgb565_scalar, always },
+    { "scalar", PixelFormat::YUV420, yuv420_scalar, always },
+#ifdef SCREEN_CONVERTER_X86
+    { "ssse3", PixelFormat::ARGB8888, argb_ssse3, has_ssse3 },
+    { "ssse3", PixelFormat::RGB565, rgb565_ssse3, has_ssse3 },
+    { "ssse3", PixelFormat::YUV420, yuv420_ssse3, has_ssse3 },
+    { "avx2", PixelFormat::ARGB8888, argb_avx2, has_avx2 },
+#endif
+};
+const size_t screen_conversions_count = std::size(screen_conversions);
+
+convert_screen_fn convert_screen(const PixelFormat format) {
+    static const std::array<convert_screen_fn, 3> best = [] {
+        std::array<convert_screen_fn, 3> best = {};
+        for (const ScreenConversion &conversion : screen_conversions) {
+            if (conversion.supported()) best[static_cast<int>(conversion.format)] = conversion.convert;
+        }
+        return best;
+    }();
+    return best[static_cast<int>(format)];
+}
+
+bool ScreenConverter::set_palette(const uint8_t palette[32], const uint8_t mask) {
+    if (resolved && mask == source_mask && !memcmp(palette, source, sizeof(source))) return false;
+    memcpy(source, palette, sizeof(source));
+    source_mask = mask;
+    resolved = true;
+
+    for (unsigned index = 0; index < 32; ++index) {
+        // Grayscale keeps only the brightness column of the master palette
+        const uint8_t colour = palette[index] & (mask & BIT_0 ? 0x30 : 0x3F);
+        unsigned red = nes_palette_raw[colour] >> 16 & 0xFF;
+        unsigned green = nes_palette_raw[colour] >> 8 & 0xFF;
+        unsigned blue = nes_palette_raw[colour] & 0xFF;
+
+        // Emphasis (bits 5-7: red, green, blue on NTSC) darkens the other channels, roughly to 3/4
+        if (mask & (BIT_6 | BIT_7)) red = red * 3 / 4;
+        if (mask & (BIT_5 | BIT_7)) green = green * 3 / 4;
+        if (mask & (BIT_5 | BIT_6)) blue = blue * 3 / 4;
+
+        rgb[index] = red << 16 | green << 8 | blue;
+        tables.argb[0][index] = blue;
+        tables.argb[1][index] = green;
+        tables.argb[2][index] = red;
+        tables.argb[3][index] = 0xFF;
+
+        const uint16_t rgb565 = (red >> 3) << 11 | (green >> 2) << 5 | blue >> 3;
+        tables.rgb565[0][index] = rgb565 & 0xFF;
+        tables.rgb565[1][index] = rgb565 >> 8;
+
+        // BT.601, limited range
+        const int r = red, g = green, b = blue;
+        tables.yuv[0][index] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+        tables.yuv[1][index] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+        tables.yuv[2][index] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    }
+    return true;
+}
+
+void ScreenConverter::convert(const uint8_t *screen, const PixelFormat format, void *pixels) const {
+    convert_screen(format)(tables, screen, pixels);
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "nes.h"
+
+namespace dendy {
+
+// Pixel layouts SCREEN converts to. YUV420 is planar: a NES_WIDTH x NES_HEIGHT Y plane, then U and V at half
+// the resolution both ways, BT.601 limited range.
+enum class PixelFormat {
+    ARGB8888,
+    RGB565,
+    YUV420,
+};
+
+// Bytes a whole frame takes in a format
+size_t frame_size(PixelFormat format);
+
+// Colours of the 32 SCREEN indexes as planes of bytes, the layout byte shuffles look them up in
+struct ScreenColours {
+    alignas(16) uint8_t argb[4][32]; // B, G, R and A: ARGB8888 in little endian memory order
+    alignas(16) uint8_t rgb565[2][32]; // Low, high byte
+    alignas(16) uint8_t yuv[3][32];
+};
+
+// Expands NES_WIDTH * NES_HEIGHT SCREEN indexes to frame_size() bytes of pixels
+using convert_screen_fn = void (*)(const ScreenColours &colours, const uint8_t *screen, void *pixels);
+
+struct ScreenConversion {
+    const char *name;
+    PixelFormat format;
+    convert_screen_fn convert;
+    bool (*supported)();
+};
+
+// Every conversion built in, the scalar references first in PixelFormat order; the SIMD ones must give exactly
+// the result of the scalar one of their format
+extern const ScreenConversion screen_conversions[];
+extern const size_t screen_conversions_count;
+
+// The fastest conversion to a format the CPU runs
+convert_screen_fn convert_screen(PixelFormat format);
+
+// Frame-end conversion of SCREEN: resolves the palette a frame was drawn with through nes_palette_raw, with the
+// grayscale and emphasis bits of PPU_MASK, into ScreenColours, again only when they change. Then converts
+// straight into the caller's buffer.
+class ScreenConverter {
+public:
+    // Palette and PPU_MASK as Console::SCREEN_PALETTE and SCREEN_MASK, returns true if the colours changed
+    bool set_palette(const uint8_t palette[32], uint8_t mask);
+
+    void convert(const uint8_t *screen, PixelFormat format, void *pixels) const;
+
+    // Colour of each SCREEN index as MFB_RGB() makes them, for frontends with a palette of their own
+    const uint32_t *palette() const { return rgb; }
+
+    const ScreenColours &colours() const { return tables; }
+
+private:
+    uint8_t source[32] = { 0 };
+    uint8_t source_mask = 0;
+    bool resolved = false;
+
+    uint32_t rgb[32] = { 0 };
+    ScreenColours tables = {};
+};
+
+}
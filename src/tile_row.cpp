@@ -0,0 +1,113 @@
+#include "tile_row.h"
+
+#include <iterator>
+
+// SSE2 is always there on x86-64, AVX2 is checked for at run time
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define TILE_ROW_X86
+#endif
+
+namespace dendy {
+
+static void expand_scalar(const TileRow &row, uint8_t *pixels) {
+    for (unsigned tile = 0; tile < TileRow::TILES; ++tile) {
+        const uint8_t low = row.low[tile];
+        const uint8_t high = row.high[tile];
+        for (uint8_t bit = 7; bit < 8; --bit) {
+            *pixels++ = row.palette[tile] | (high >> bit & 1) << 1 | low >> bit & 1;
+        }
+    }
+}
+
+static bool always() {
+    return true;
+}
+
+#ifdef TILE_ROW_X86
+// SSE2 has no byte shuffle: each plane byte is doubled up three times with unpacks, giving 8 copies of it,
+// then compared against the pixel bit masks. 16 tiles make 8 registers of two tiles each.
+static inline void spread_sse2(const __m128i bytes, __m128i out[8]) {
+    const __m128i lo = _mm_unpacklo_epi8(bytes, bytes);
+    const __m128i hi = _mm_unpackhi_epi8(bytes, bytes);
+    const __m128i quads[4] = {
+        _mm_unpacklo_epi16(lo, lo), _mm_unpackhi_epi16(lo, lo), _mm_unpacklo_epi16(hi, hi), _mm_unpackhi_epi16(hi, hi),
+    };
+    for (unsigned i = 0; i < 4; ++i) {
+        out[i * 2] = _mm_unpacklo_epi32(quads[i], quads[i]);
+        out[i * 2 + 1] = _mm_unpackhi_epi32(quads[i], quads[i]);
+    }
+}
+
+static void expand_sse2(const TileRow &row, uint8_t *pixels) {
+    const __m128i masks = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i ones = _mm_set1_epi8(1);
+    const __m128i twos = _mm_set1_epi8(2);
+
+    for (unsigned tile = 0; tile < TileRow::PADDED; tile += 16) {
+        __m128i low[8], high[8], palette[8];
+        spread_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&row.low[tile])), low);
+        spread_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&row.high[tile])), high);
+        spread_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&row.palette[tile])), palette);
+
+        for (unsigned i = 0; i < 8; ++i) {
+            const __m128i bit0 = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(low[i], masks), masks), ones);
+            const __m128i bit1 = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(high[i], masks), masks), twos);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(&pixels[(tile + i * 2) * 8]),
+                             _mm_or_si128(_mm_or_si128(bit0, bit1), palette[i]));
+        }
+    }
+}
+
+// AVX2 spreads four tiles into a register with one in-lane byte shuffle per plane
+__attribute__((target("avx2"))) static void expand_avx2(const TileRow &row, uint8_t *pixels) {
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i masks = _mm256_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1,
+                                           -128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+    const __m256i ones = _mm256_set1_epi8(1);
+    const __m256i twos = _mm256_set1_epi8(2);
+
+    for (unsigned tile = 0; tile < TileRow::TILES; tile += 4) { // TILES rounded up to 4, within PADDED
+        int low, high, palette;
+        __builtin_memcpy(&low, &row.low[tile], 4);
+        __builtin_memcpy(&high, &row.high[tile], 4);
+        __builtin_memcpy(&palette, &row.palette[tile], 4);
+
+        const __m256i l = _mm256_shuffle_epi8(_mm256_set1_epi32(low), spread);
+        const __m256i h = _mm256_shuffle_epi8(_mm256_set1_epi32(high), spread);
+        const __m256i p = _mm256_shuffle_epi8(_mm256_set1_epi32(palette), spread);
+
+        const __m256i bit0 = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(l, masks), masks), ones);
+        const __m256i bit1 = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(h, masks), masks), twos);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(&pixels[tile * 8]),
+                            _mm256_or_si256(_mm256_or_si256(bit0, bit1), p));
+    }
+}
+
+static bool has_avx2() {
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+const TileExpander tile_expanders[] = {
+    { "scalar", expand_scalar, always },
+#ifdef TILE_ROW_X86
+    { "sse2", expand_sse2, always },
+    { "avx2", expand_avx2, has_avx2 },
+#endif
+};
+const size_t tile_expanders_count = std::size(tile_expanders);
+
+expand_tiles_fn expand_tiles() {
+    static const expand_tiles_fn best = [] {
+        expand_tiles_fn expand = expand_scalar;
+        for (const TileExpander &expander : tile_expanders) {
+            if (expander.supported()) expand = expander.expand;
+        }
+        return expand;
+    }();
+    return best;
+}
+
+}
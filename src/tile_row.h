@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace dendy {
+
+// Background tiles of one scanline before expansion to pixels: the pattern row of every tile and its palette.
+// A line shows parts of 33 tiles once scrolled by fine X; the rest up to PADDED is expanded too, as garbage,
+// so the SIMD versions work in whole registers.
+struct TileRow {
+    static constexpr unsigned TILES = 33;
+    static constexpr unsigned PADDED = 48;
+
+    uint8_t low[PADDED]; // Bitplane 0
+    uint8_t high[PADDED]; // Bitplane 1
+    uint8_t palette[PADDED]; // Attribute palette already in bits 2-3
+};
+
+// Expands a TileRow to pixels of 4-bit colour, bit 7 of the planes leftmost. The first TILES * 8 are the
+// result, there must be room for PADDED * 8.
+using expand_tiles_fn = void (*)(const TileRow &row, uint8_t *pixels);
+
+struct TileExpander {
+    const char *name;
+    expand_tiles_fn expand;
+    bool (*supported)();
+};
+
+// Every expander built in, the scalar reference first; the SIMD ones must give exactly its result
+extern const TileExpander tile_expanders[];
+extern const size_t tile_expanders_count;
+
+// The fastest expander the CPU runs, picked on first use
+expand_tiles_fn expand_tiles();
+
+}
@@ -1,6 +1,6 @@
 #if !PICO_ON_DEVICE
 
-#include "MiniFB.h"
+#include "../MiniFB.h"
 
 #define WIN32_LEAN_AND_MEAN
 
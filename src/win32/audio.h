@@ -1,96 +1,61 @@
 #pragma once
 #include <windows.h>
+#include <mmsystem.h>
 #include <stdint.h>
-HANDLE updateEvent;
 
-#define SOUND_FREQUENCY 44100
-#define AUDIO_BUFFER_LENGTH ((SOUND_FREQUENCY / 10))
-static int16_t audio_buffer[AUDIO_BUFFER_LENGTH * 2] = { 0 };
-static int sample_index = 0;
-
-DWORD WINAPI SoundThread(LPVOID lpParam) {
-    WAVEHDR waveHeaders[4];
-
-    WAVEFORMATEX format = {0};
-    format.wFormatTag = WAVE_FORMAT_PCM;
-    format.nChannels = 2;
-    format.nSamplesPerSec = SOUND_FREQUENCY;
-    format.wBitsPerSample = 16;
-    format.nBlockAlign = format.nChannels * format.wBitsPerSample / 8;
-    format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+#include "../audio_ring.h"
 
-    HANDLE waveEvent = CreateEvent(NULL, 1, 0, NULL);
-
-    HWAVEOUT hWaveOut;
-    waveOutOpen(&hWaveOut, WAVE_MAPPER, &format, (DWORD_PTR) waveEvent, 0, CALLBACK_EVENT);
-
-    for (size_t i = 0; i < 4; i++) {
-        int16_t audio_buffers[4][AUDIO_BUFFER_LENGTH * 2];
-        waveHeaders[i] = (WAVEHDR){
-            .lpData = (char *) audio_buffers[i],
-            .dwBufferLength = AUDIO_BUFFER_LENGTH * 2,
-        };
-        waveOutPrepareHeader(hWaveOut, &waveHeaders[i], sizeof(WAVEHDR));
-        waveHeaders[i].dwFlags |= WHDR_DONE;
+#define SOUND_FREQUENCY 44100
+// Samples in each of the device's buffers, 10 ms of them
+#define AUDIO_BUFFER_LENGTH (SOUND_FREQUENCY / 100)
+#define AUDIO_BUFFERS 4
+
+static HWAVEOUT hWaveOut;
+static HANDLE waveEvent;
+
+// Plays the AudioRing passed in lpParam through the device StartSound() opened. The device signals the event as
+// it finishes a buffer, which is then refilled from the ring (silence where the emulation hasn't caught up) and
+// queued again. Nothing runs in between.
+static DWORD WINAPI SoundThread(LPVOID lpParam) {
+    dendy::AudioRing &ring = *static_cast<dendy::AudioRing *>(lpParam);
+    static int16_t buffers[AUDIO_BUFFERS][AUDIO_BUFFER_LENGTH];
+    WAVEHDR headers[AUDIO_BUFFERS] = {};
+
+    for (size_t i = 0; i < AUDIO_BUFFERS; i++) {
+        headers[i].lpData = (char *) buffers[i];
+        headers[i].dwBufferLength = sizeof(buffers[i]);
+        waveOutPrepareHeader(hWaveOut, &headers[i], sizeof(WAVEHDR));
+        headers[i].dwFlags |= WHDR_DONE;
     }
-    WAVEHDR *currentHeader = waveHeaders;
-
 
+    // Buffers finish in the order they were queued in
+    size_t current = 0;
     while (1) {
-        if (WaitForSingleObject(waveEvent, INFINITE)) {
-            //            fprintf(stderr, "Failed to wait for event.\n");
-            return 1;
+        while (headers[current].dwFlags & WHDR_DONE) {
+            ring.play((int16_t *) headers[current].lpData, AUDIO_BUFFER_LENGTH);
+            waveOutWrite(hWaveOut, &headers[current], sizeof(WAVEHDR));
+            current = (current + 1) % AUDIO_BUFFERS;
         }
 
-        if (!ResetEvent(waveEvent)) {
-            //            fprintf(stderr, "Failed to reset event.\n");
+        if (WaitForSingleObject(waveEvent, INFINITE) != WAIT_OBJECT_0)
             return 1;
-        }
-
-        // Wait until audio finishes playing
-        while (currentHeader->dwFlags & WHDR_DONE) {
-            WaitForSingleObject(updateEvent, INFINITE);
-            ResetEvent(updateEvent);
-            //            PSG_calc_stereo(&psg, audiobuffer, AUDIO_BUFFER_LENGTH);
-            memcpy(currentHeader->lpData, audio_buffer, AUDIO_BUFFER_LENGTH * 2);
-            waveOutWrite(hWaveOut, currentHeader, sizeof(WAVEHDR));
-            //waveOutPrepareHeader(hWaveOut, currentHeader, sizeof(WAVEHDR));
-            currentHeader++;
-            if (currentHeader == waveHeaders + 4) { currentHeader = waveHeaders; }
-        }
     }
-    return 0;
 }
 
-DWORD WINAPI TicksThread(LPVOID lpParam) {
-    LARGE_INTEGER start, current, queryperf;
-
-
-    QueryPerformanceFrequency(&queryperf);
-    uint32_t hostfreq = (uint32_t) queryperf.QuadPart;
-
-    QueryPerformanceCounter(&start); // Get the starting time
-    uint32_t last_sound_tick = 0;
-
-
-    updateEvent = CreateEvent(NULL, 1, 1, NULL);
-    while (1) {
-        QueryPerformanceCounter(&current); // Get the current time
-
-        // Calculate elapsed time in ticks since the start
-        uint32_t elapsedTime = (uint32_t) (current.QuadPart - start.QuadPart);
-
-        if (elapsedTime - last_sound_tick >= hostfreq / SOUND_FREQUENCY) {
-            const int16_t sample = 0;// sn76489_sample();
-            audio_buffer[sample_index++] = sample;
-            audio_buffer[sample_index++] = sample;
+// Opens the default device for the mono samples of ring and starts SoundThread on it. False if there's no device,
+// so nothing will take samples out of the ring.
+static bool StartSound(dendy::AudioRing *ring) {
+    WAVEFORMATEX format = {0};
+    format.wFormatTag = WAVE_FORMAT_PCM;
+    format.nChannels = 1;
+    format.nSamplesPerSec = SOUND_FREQUENCY;
+    format.wBitsPerSample = 16;
+    format.nBlockAlign = format.nChannels * format.wBitsPerSample / 8;
+    format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
 
-            if (sample_index >= AUDIO_BUFFER_LENGTH) {
-                SetEvent(updateEvent);
-                sample_index = 0;
-            }
+    waveEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (waveOutOpen(&hWaveOut, WAVE_MAPPER, &format, (DWORD_PTR) waveEvent, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR)
+        return false;
 
-            last_sound_tick = elapsedTime;
-        }
-    }
-}
\ No newline at end of file
+    return CreateThread(NULL, 0, SoundThread, ring, 0, NULL) != NULL;
+}